@@ -0,0 +1,179 @@
+/*
+
+  bench.c
+
+  Copyright 2015 Matthew T. Pandina. All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY MATTHEW T. PANDINA "AS IS" AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHEW T. PANDINA OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+  USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+  Measures the number of bytes read from, written to and erased in the
+  simulated EEPROM, the time an AVR would have been busy, and the time
+  actually taken, by each call to the wear-leveling functions. This is
+  built and run by "make -f Makefile.linux bench", once for each
+  EEPROM_WEAR_LEVEL_FACTOR in BENCH_FACTORS, using the rest of the
+  configuration in eeprom.mk (or given on the command line).
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "eeprom.h"
+
+#if (!EEPROM_SIMULATED_COUNTERS)
+#error "bench.c requires EEPROM_SIMULATED_COUNTERS = 1"
+#endif // EEPROM_SIMULATED_COUNTERS
+
+#define BENCH_ITERATIONS 20000
+#define BENCH_MAX_LEN 32
+
+// How the value being written changes from one write to the next
+enum { PATTERN_SAME, PATTERN_ONE_BYTE, PATTERN_ALL_BYTES, PATTERN_COUNT };
+static const char *const PatternNames[PATTERN_COUNT] = { "same", "one byte", "all bytes" };
+
+static uint8_t BenchData[BENCH_MAX_LEN];
+
+static void BenchNextValue(const uint8_t pattern, const uint16_t len) {
+  if (pattern == PATTERN_ONE_BYTE)
+    ++BenchData[0];
+  else if (pattern == PATTERN_ALL_BYTES)
+    for (uint16_t i = 0; i < len; ++i)
+      ++BenchData[i];
+}
+
+static void BenchWait(void) {
+#if (EEPROM_WRITE_QUEUE_SIZE)
+  EEPROM_FlushWrites();
+#endif // EEPROM_WRITE_QUEUE_SIZE
+}
+
+static double BenchNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void BenchReport(const char *api, const uint16_t len, const char *pattern, const double begin) {
+  double ns = BenchNow() - begin;
+  EEPROM_SimulatedStats stats;
+  EEPROM_GetSimulatedStats(&stats);
+  printf("%-6s %4u  %-9s %10.2f %10.2f %10.2f %10.2f %10.1f %10.1f\n", api, len, pattern,
+         (double)stats.reads / BENCH_ITERATIONS,
+         (double)stats.writes / BENCH_ITERATIONS,
+         (double)stats.erases / BENCH_ITERATIONS,
+         (double)stats.pages / BENCH_ITERATIONS,
+         stats.busy / 1e3 / BENCH_ITERATIONS,
+         ns / BENCH_ITERATIONS);
+}
+
+static void BenchReset(void) {
+  memset(eeprom, 0xFF, sizeof(eeprom));
+  memset(BenchData, 0, sizeof(BenchData));
+#if (EEPROM_CACHE_SIZE)
+  EEPROM_InvalidateCache();
+#endif // EEPROM_CACHE_SIZE
+}
+
+#if (EEPROM_INCLUDE_BYTE_FUNCS)
+static void BenchBytes(void) {
+  double begin;
+  for (uint8_t pattern = PATTERN_SAME; pattern <= PATTERN_ONE_BYTE; ++pattern) {
+    BenchReset();
+    EEPROM_InitWearLeveledByte(0, BenchData[0]);
+    BenchWait();
+
+    EEPROM_ResetSimulatedStats();
+    begin = BenchNow();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+      BenchNextValue(pattern, 1);
+      EEPROM_WriteWearLeveledByte(0, BenchData[0]);
+      BenchWait();
+    }
+    BenchReport("wbyte", 1, PatternNames[pattern], begin);
+
+    EEPROM_ResetSimulatedStats();
+    begin = BenchNow();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i)
+      BenchData[0] ^= EEPROM_ReadWearLeveledByte(0);
+    BenchReport("rbyte", 1, PatternNames[pattern], begin);
+  }
+}
+#endif // EEPROM_INCLUDE_BYTE_FUNCS
+
+#if (EEPROM_INCLUDE_BLOCK_FUNCS)
+static const uint16_t BenchLengths[] = { 1, 2, 4, 8, 16, 32 };
+
+static void BenchBlocks(void) {
+  uint8_t data[BENCH_MAX_LEN];
+  double begin;
+  for (uint8_t l = 0; l < sizeof(BenchLengths) / sizeof(BenchLengths[0]); ++l) {
+    uint16_t len = BenchLengths[l];
+    if (EE_BLOCK_SEGMENT_SIZE(len) > sizeof(eeprom))
+      break;
+    for (uint8_t pattern = PATTERN_SAME; pattern < PATTERN_COUNT; ++pattern) {
+      BenchReset();
+      EEPROM_InitWearLeveledBlock(0, BenchData, len);
+      BenchWait();
+
+      EEPROM_ResetSimulatedStats();
+      begin = BenchNow();
+      for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+        BenchNextValue(pattern, len);
+        EEPROM_WriteWearLeveledBlock(0, BenchData, len);
+        BenchWait();
+      }
+      BenchReport("wblock", len, PatternNames[pattern], begin);
+
+      EEPROM_ResetSimulatedStats();
+      begin = BenchNow();
+      for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+        EEPROM_ReadWearLeveledBlock(0, data, len);
+        BenchData[0] ^= data[0];
+      }
+      BenchReport("rblock", len, PatternNames[pattern], begin);
+    }
+  }
+}
+#endif // EEPROM_INCLUDE_BLOCK_FUNCS
+
+int main(void) {
+  printf("EEPROM_WEAR_LEVEL_FACTOR = %u, EEPROM_ROTATE_WHOLE_BLOCKS = %u, EEPROM_CACHE_SIZE = %u, "
+         "EEPROM_BINARY_SEARCH = %u, EEPROM_WRITE_QUEUE_SIZE = %u, EEPROM_BACKEND = %u\n",
+         EEPROM_WEAR_LEVEL_FACTOR, EEPROM_ROTATE_WHOLE_BLOCKS, EEPROM_CACHE_SIZE,
+         EEPROM_BINARY_SEARCH, EEPROM_WRITE_QUEUE_SIZE, EEPROM_BACKEND);
+  printf("%-6s %4s  %-9s %10s %10s %10s %10s %10s %10s\n", "api", "len", "pattern",
+         "reads/op", "writes/op", "erases/op", "pages/op", "busy us/op", "ns/op");
+#if (EEPROM_INCLUDE_BYTE_FUNCS)
+  BenchBytes();
+#endif // EEPROM_INCLUDE_BYTE_FUNCS
+#if (EEPROM_INCLUDE_BLOCK_FUNCS)
+  BenchBlocks();
+#endif // EEPROM_INCLUDE_BLOCK_FUNCS
+  printf("\n");
+  return 0;
+}
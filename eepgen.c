@@ -0,0 +1,93 @@
+/*
+
+  eepgen.c
+
+  Copyright 2015 Matthew T. Pandina. All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY MATTHEW T. PANDINA "AS IS" AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHEW T. PANDINA OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+  USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+  Generates an Intel HEX image of the EEPROM, holding every parameter
+  already initialized, which avrdude can program into a device along
+  with its firmware, so that the device never has to initialize its
+  parameters on first boot. The parameters are initialized by
+  EEPROM_Provision(), using the usual initialization functions on the
+  simulated EEPROM, so the image matches the configuration in
+  eeprom.mk. This is built and run by "make -f Makefile.linux eep",
+  which writes the image to the file named by its only argument, or
+  to stdout when there is none.
+
+  Note: The types of the parameters must have the same size and byte
+        order on the computer as on the AVR, such as fixed-width
+        integer types and packed structs.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include "eeprom.h"
+
+#define EEPGEN_RECORD_SIZE 16
+#define EEPGEN_DATA 0x00
+#define EEPGEN_END_OF_FILE 0x01
+
+// Initializes every parameter, and must be provided along with this file
+void EEPROM_Provision(void);
+
+static void EepgenRecord(FILE *file, const uint16_t address, const uint8_t type, const uint8_t *data, const uint8_t len) {
+  uint8_t sum = len + (address >> 8) + (address & 0xFF) + type;
+  fprintf(file, ":%02X%04X%02X", len, address, type);
+  for (uint8_t i = 0; i < len; ++i) {
+    fprintf(file, "%02X", data[i]);
+    sum += data[i];
+  }
+  fprintf(file, "%02X\n", (uint8_t)-sum);
+}
+
+int main(int argc, char *argv[]) {
+  FILE *file = stdout;
+  if (argc > 1 && !(file = fopen(argv[1], "w"))) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  EEPROM_Provision();
+#if (EEPROM_WRITE_QUEUE_SIZE)
+  EEPROM_FlushWrites();
+#endif // EEPROM_WRITE_QUEUE_SIZE
+
+  for (uint32_t address = 0; address < sizeof(eeprom); address += EEPGEN_RECORD_SIZE) {
+    uint8_t len = sizeof(eeprom) - address < EEPGEN_RECORD_SIZE ? sizeof(eeprom) - address : EEPGEN_RECORD_SIZE;
+    EepgenRecord(file, address, EEPGEN_DATA, &eeprom[address], len);
+  }
+  EepgenRecord(file, 0, EEPGEN_END_OF_FILE, NULL, 0);
+
+  if (file != stdout && fclose(file)) {
+    perror(argv[1]);
+    return 1;
+  }
+  return 0;
+}
@@ -32,33 +32,793 @@
 
 */
 
+#include <stddef.h>
 #include "eeprom.h"
 
 // Define the number of levels in the buffer (8 levels will guarantee 800k writes)
 #define EE_PARAM_BUFFER_SIZE  EEPROM_WEAR_LEVEL_FACTOR
 #define EE_STATUS_BUFFER_SIZE  EE_PARAM_BUFFER_SIZE
+#if (!EE_VALID_LEVELS(EEPROM_WEAR_LEVEL_FACTOR))
+#error "EEPROM_WEAR_LEVEL_FACTOR must be between 1 and EE_MAX_LEVELS (see EEPROM_WIDE_LEVELS), and not a multiple of 256 unless EEPROM_BIT_CLEARING_STATUS = 1"
+#endif // EE_VALID_LEVELS(EEPROM_WEAR_LEVEL_FACTOR)
+
+/*
+All of the state of the library. On a computer, there is one of these
+for each simulated EEPROM (see EEPROM_CreateInstance), and EE_STATE is
+the one selected by the calling thread. On an AVR, there is only ever
+one, which is accessed directly. */
+#if (!defined(F_CPU) || EEPROM_BACKEND == 1 || EEPROM_WRITE_QUEUE_SIZE || EEPROM_CACHE_SIZE || EEPROM_WRITE_BACK_SIZE || EEPROM_LOG_SIZE || EEPROM_PROFILING || EEPROM_DEFERRED_WRITES)
+struct EEPROM_Instance {
+#ifndef F_CPU
+  uint8_t memory[EEPROM_SIMULATED_SIZE];
+#if (EEPROM_SIMULATED_COUNTERS)
+  EEPROM_SimulatedStats stats;
+  uint32_t cellErases[EEPROM_SIMULATED_SIZE];
+  uint32_t cellWrites[EEPROM_SIMULATED_SIZE];
+#endif // EEPROM_SIMULATED_COUNTERS
+#endif // F_CPU
+#if (EEPROM_BACKEND == 1)
+  // The writes that have been combined into the next page write
+  uint16_t pageAddress;
+  uint16_t pageLength;
+  uint8_t pageData[EEPROM_PAGE_SIZE];
+#endif // EEPROM_BACKEND
+#if (EEPROM_WRITE_QUEUE_SIZE)
+  // A ring buffer of the writes that have not yet been started
+  volatile uint16_t queueAddress[EEPROM_WRITE_QUEUE_SIZE];
+  volatile uint8_t queueData[EEPROM_WRITE_QUEUE_SIZE];
+  volatile uint8_t queueHead; // the oldest queued write
+  volatile uint8_t queueCount;
+#endif // EEPROM_WRITE_QUEUE_SIZE
+#if (EEPROM_CACHE_SIZE)
+  // The status buffers of the segments whose current level is known,
+  // and that level
+  uint16_t cacheStatus[EEPROM_CACHE_SIZE];
+  EEPROM_Level cacheLevel[EEPROM_CACHE_SIZE];
+  uint8_t cacheCount;
+#endif // EEPROM_CACHE_SIZE
+#if (EEPROM_WRITE_BACK_SIZE)
+  const EEPROM_Parameter *writeBackParams;
+  uint8_t writeBackCount;
+  // One bit for each parameter whose value in memory has changed
+  uint8_t dirty[(EEPROM_WRITE_BACK_SIZE - 1) / 8 + 1];
+#endif // EEPROM_WRITE_BACK_SIZE
+#if (EEPROM_LOG_SIZE)
+  // The address of the latest record of each key, or 0 if it has none
+  uint16_t logIndex[EEPROM_LOG_KEYS];
+  uint16_t logArea; // the area of the log holding the current records
+  uint16_t logEnd; // the address after the last record
+  uint8_t logCompacting; // the step of the compaction in progress
+  uint8_t logCopyKey; // the next key to copy into the other area
+  uint16_t logCopyAddress; // the next address of the other area to erase, or to copy into
+  int16_t logBudget; // the number of bytes the compaction in progress is ahead or behind by
+#endif // EEPROM_LOG_SIZE
+#if (EEPROM_PROFILING)
+  EEPROM_ProfileStats profile[EE_PROFILE_COUNT];
+  uint8_t profileDepth; // the number of measured calls in progress
+  uint8_t profileWritten; // whether the outermost one wrote anything
+#endif // EEPROM_PROFILING
+#if (EEPROM_DEFERRED_WRITES)
+  // A ring buffer of the byte writes made by interrupt handlers
+  volatile uint16_t deferredParam[EEPROM_DEFERRED_WRITES];
+  volatile uint8_t deferredData[EEPROM_DEFERRED_WRITES];
+  volatile uint8_t deferredHead; // the oldest deferred write
+  volatile uint8_t deferredCount;
+#endif // EEPROM_DEFERRED_WRITES
+};
+
+#ifdef F_CPU
+static struct EEPROM_Instance EeState;
+#define EE_STATE EeState
+#else // F_CPU
+static struct EEPROM_Instance EeDefaultState = { .memory = { [0 ... EEPROM_SIMULATED_SIZE - 1] = 0xFF } };
+static __thread struct EEPROM_Instance *EeSelectedState = &EeDefaultState;
+#define EE_STATE (*EeSelectedState)
+#endif // F_CPU
+#endif // !F_CPU || EEPROM_BACKEND == 1 || EEPROM_WRITE_QUEUE_SIZE || EEPROM_CACHE_SIZE || EEPROM_WRITE_BACK_SIZE || EEPROM_LOG_SIZE || EEPROM_PROFILING || EEPROM_DEFERRED_WRITES
 
 #ifdef F_CPU
 #include <avr/eeprom.h>
+#include <util/atomic.h>
+// Older devices use different names for these bits
+#ifndef EEPE
+#define EEPE EEWE
+#define EEMPE EEMWE
+#endif // EEPE
+#if (EEPROM_WRITE_QUEUE_SIZE || EEPROM_SLEEP_WHILE_PROGRAMMING)
+#include <avr/interrupt.h>
+// Older devices use a different name for this vector
+#ifdef EE_READY_vect
+#define EE_READY_VECTOR EE_READY_vect
+#else // EE_READY_vect
+#define EE_READY_VECTOR EE_RDY_vect
+#endif // EE_READY_vect
+#endif // EEPROM_WRITE_QUEUE_SIZE || EEPROM_SLEEP_WHILE_PROGRAMMING
+#if (EEPROM_SLEEP_WHILE_PROGRAMMING)
+#include <avr/sleep.h>
+/*
+Waits in idle sleep for the write in progress to finish, woken by the
+EEPROM Ready interrupt, rather than spinning like eeprom_busy_wait().
+Interrupts are enabled while sleeping, so when they are disabled, the
+wait spins instead. The interrupt is checked for with interrupts
+disabled, and sleep_cpu() directly follows sei(), which always
+executes the next instruction first, so the interrupt cannot be
+missed. The bits of the sleep mode that are changed to select idle
+sleep are changed back afterwards, so the sleep mode the application
+selected is kept. */
+static void EEPROM_SleepWhileBusy(void) {
+  uint8_t sreg = SREG;
+  if (!(sreg & _BV(SREG_I))) {
+    eeprom_busy_wait();
+    return;
+  }
+
+  cli();
+  uint8_t sleepControl = _SLEEP_CONTROL_REG;
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  uint8_t changed = sleepControl ^ _SLEEP_CONTROL_REG;
+  while (EECR & _BV(EEPE)) {
+    EECR |= _BV(EERIE);
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    cli();
+  }
+  _SLEEP_CONTROL_REG ^= changed;
+  SREG = sreg;
+}
+#if (EEPROM_SLEEP_WHILE_PROGRAMMING == 2)
+#if (EEPROM_WRITE_QUEUE_SIZE)
+#error "EEPROM_WRITE_QUEUE_SIZE requires EEPROM_SLEEP_WHILE_PROGRAMMING = 1, since the write queue handles the EEPROM Ready interrupt"
+#endif // EEPROM_WRITE_QUEUE_SIZE
+#elif (EEPROM_WRITE_QUEUE_SIZE == 0)
+// Only wakes the CPU up (the write queue has its own handler, which
+// also does this once the queue is empty)
+ISR(EE_READY_VECTOR) {
+  EECR &= ~_BV(EERIE);
+}
+#endif // EEPROM_SLEEP_WHILE_PROGRAMMING == 2
+#define EEPROM_BusyWait() EEPROM_SleepWhileBusy()
+#else // EEPROM_SLEEP_WHILE_PROGRAMMING
+#define EEPROM_BusyWait() eeprom_busy_wait()
+#endif // EEPROM_SLEEP_WHILE_PROGRAMMING
+#if (EEPROM_BACKEND == 0)
+#if (EEPROM_SLEEP_WHILE_PROGRAMMING && !EEPROM_WRITE_QUEUE_SIZE)
+// avr-libc waits for the previous write to finish at the start of each
+// access, so the wait is done first, while sleeping
+#define EEPROM_Read(address) (EEPROM_SleepWhileBusy(), eeprom_read_byte((uint8_t *)(uint16_t)(address)))
+#define EEPROM_ReadBlock(data, address, len) (EEPROM_SleepWhileBusy(), eeprom_read_block((data), (const void *)(uint16_t)(address), (len)))
+#else // EEPROM_SLEEP_WHILE_PROGRAMMING && !EEPROM_WRITE_QUEUE_SIZE
 #define EEPROM_Read(address) eeprom_read_byte((uint8_t *)(uint16_t)(address))
+#define EEPROM_ReadBlock(data, address, len) eeprom_read_block((data), (const void *)(uint16_t)(address), (len))
+#endif // EEPROM_SLEEP_WHILE_PROGRAMMING && !EEPROM_WRITE_QUEUE_SIZE
+#if (EEPROM_SPLIT_PROGRAMMING)
+#ifndef EEPM0
+#error "EEPROM_SPLIT_PROGRAMMING is not supported by this device"
+#endif // EEPM0
+/*
+Returns the EEPROM programming mode bits needed to change the old
+value of a byte into the new value. Erasing sets every bit of a byte,
+and writing can only clear bits, so a byte that only needs bits set
+to become 0xFF is just erased, and a byte that only needs bits cleared
+is just written, each of which takes about half as long as an atomic
+erase and write. */
+static uint8_t EEPROM_ProgrammingMode(const uint8_t oldData, const uint8_t data) {
+  if (data == 0xFF)
+    return _BV(EEPM0); // erase only
+  if ((oldData & data) == data)
+    return _BV(EEPM1); // write only
+  return 0; // erase and write
+}
+#endif // EEPROM_SPLIT_PROGRAMMING
+#if (EEPROM_SPLIT_PROGRAMMING && !EEPROM_WRITE_QUEUE_SIZE)
+static void EEPROM_SplitWrite(const uint16_t address, const uint8_t data) {
+  EEPROM_BusyWait();
+  EEAR = address;
+  EECR |= _BV(EERE);
+  uint8_t oldData = EEDR;
+  if (oldData != data) {
+    EECR = (EECR & ~(_BV(EEPM1) | _BV(EEPM0))) | EEPROM_ProgrammingMode(oldData, data);
+    EEDR = data;
+    // EEPE must be set within four cycles of EEMPE, which is the only
+    // part of a write that needs interrupts disabled
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      EECR |= _BV(EEMPE);
+      EECR |= _BV(EEPE);
+    }
+  }
+}
+#define EEPROM_Write(address, data) EEPROM_SplitWrite((address), (data))
+#else // EEPROM_SPLIT_PROGRAMMING && !EEPROM_WRITE_QUEUE_SIZE
+#if (EEPROM_SLEEP_WHILE_PROGRAMMING && !EEPROM_WRITE_QUEUE_SIZE)
+#define EEPROM_Write(address, data) (EEPROM_SleepWhileBusy(), eeprom_update_byte((uint8_t *)(uint16_t)(address), (data)))
+#else // EEPROM_SLEEP_WHILE_PROGRAMMING && !EEPROM_WRITE_QUEUE_SIZE
 #define EEPROM_Write(address, data) eeprom_update_byte((uint8_t *)(uint16_t)(address), (data))
+#endif // EEPROM_SLEEP_WHILE_PROGRAMMING && !EEPROM_WRITE_QUEUE_SIZE
+#endif // EEPROM_SPLIT_PROGRAMMING && !EEPROM_WRITE_QUEUE_SIZE
+#endif // EEPROM_BACKEND
 #else // F_CPU
-// Only used for simulation when compiled on a computer
-uint8_t eeprom[EEPROM_SIMULATED_SIZE] = { [0 ... EEPROM_SIMULATED_SIZE - 1] = 0xFF };
-#define EEPROM_Read(address) eeprom[(address)]
-#define EEPROM_Write(address, data) eeprom[(address)] = (data)
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+// The simulated EEPROM has no interrupts to disable
+#define ATOMIC_BLOCK(type) for (uint8_t EeOnce = 1; EeOnce; EeOnce = 0)
+#if (EEPROM_SIMULATED_COUNTERS)
+// The simulated cost of each access, in nanoseconds, taken from the
+// datasheet of an ATmega328P running at 16 MHz (a read halts the CPU
+// for 4 cycles)
+#define EE_SIMULATED_READ_NS  250
+#define EE_SIMULATED_ERASE_WRITE_NS  3400000
+#define EE_SIMULATED_ERASE_NS  1800000
+#define EE_SIMULATED_WRITE_NS  1800000
+// and of a 24LC256 with a 400 kHz I2C bus (sending the address of a
+// read takes 4 bytes, and each byte read takes 9 bits)
+#define EE_SIMULATED_EXTERNAL_ADDRESS_NS  90000
+#define EE_SIMULATED_EXTERNAL_READ_NS  22500
+#define EE_SIMULATED_PAGE_WRITE_NS  5000000
+// The number of erase cycles each byte is guaranteed to endure
+#define EE_SIMULATED_ENDURANCE  100000
+
+#if (EEPROM_BACKEND == 0)
+static inline uint8_t EEPROM_SimulatedRead(const uint16_t address) {
+  ++EE_STATE.stats.reads;
+  EE_STATE.stats.busy += EE_SIMULATED_READ_NS;
+  return EE_STATE.memory[address];
+}
+
+static inline void EEPROM_SimulatedReadBlock(void *data, const uint16_t address, const uint16_t len) {
+  EE_STATE.stats.reads += len;
+  EE_STATE.stats.busy += (uint64_t)EE_SIMULATED_READ_NS * len;
+  memcpy(data, &EE_STATE.memory[address], len);
+}
+
+// Like eeprom_update_byte, only bytes that change are written
+static inline void EEPROM_SimulatedWrite(const uint16_t address, const uint8_t data) {
+  uint8_t oldData = EE_STATE.memory[address];
+  if (oldData == data)
+    return;
+
+  uint8_t erase = 1;
+  uint8_t write = 1;
+#if (EEPROM_SPLIT_PROGRAMMING)
+  // The same decision as EEPROM_ProgrammingMode makes on an AVR
+  if (data == 0xFF)
+    write = 0;
+  else if ((oldData & data) == data)
+    erase = 0;
+#endif // EEPROM_SPLIT_PROGRAMMING
+
+  ++EE_STATE.stats.writes;
+  ++EE_STATE.cellWrites[address];
+  if (erase) {
+    ++EE_STATE.stats.erases;
+    ++EE_STATE.cellErases[address];
+  }
+  EE_STATE.stats.busy += (erase && write) ? EE_SIMULATED_ERASE_WRITE_NS : erase ? EE_SIMULATED_ERASE_NS : EE_SIMULATED_WRITE_NS;
+  EE_STATE.memory[address] = data;
+}
+#endif // EEPROM_BACKEND
+
+void EEPROM_GetSimulatedStats(EEPROM_SimulatedStats *stats) {
+  *stats = EE_STATE.stats;
+}
+
+void EEPROM_ResetSimulatedStats(void) {
+  memset(&EE_STATE.stats, 0, sizeof(EE_STATE.stats));
+  memset(EE_STATE.cellErases, 0, sizeof(EE_STATE.cellErases));
+  memset(EE_STATE.cellWrites, 0, sizeof(EE_STATE.cellWrites));
+}
+
+uint32_t EEPROM_SimulatedCellErases(const uint16_t address) {
+  return EE_STATE.cellErases[address];
+}
+
+uint32_t EEPROM_SimulatedCellWrites(const uint16_t address) {
+  return EE_STATE.cellWrites[address];
+}
+
+void EEPROM_PrintWear(const uint16_t begin, const uint16_t end) {
+  uint32_t most = 0;
+  for (uint16_t i = begin; i < end; ++i)
+    if (EE_STATE.cellErases[i] > most)
+      most = EE_STATE.cellErases[i];
+
+  // Each byte is shown as '.' if it was never erased, or as a digit
+  // from 0 to 9 proportional to how often it was erased
+  printf("-----------------------------------------------\n");
+  for (uint16_t i = begin; i < end; ++i) {
+    char heat = EE_STATE.cellErases[i] ? '0' + (char)((uint64_t)EE_STATE.cellErases[i] * 9 / most) : '.';
+    printf(" %c %s", heat, (i + 1) % 16 ? "" : "\n");
+  }
+  printf("-----------------------------------------------\n");
+  printf("Most erases of a byte: %u (%.3f%% of %u)\n", most, 100.0 * most / EE_SIMULATED_ENDURANCE, EE_SIMULATED_ENDURANCE);
+  printf("Reads: %u, writes: %u, erases: %u, page writes: %u\n", EE_STATE.stats.reads, EE_STATE.stats.writes, EE_STATE.stats.erases, EE_STATE.stats.pages);
+  printf("Busy time: %.3f s\n", EE_STATE.stats.busy / 1e9);
+}
+#endif // EEPROM_SIMULATED_COUNTERS
+#if (EEPROM_BACKEND == 0)
+#if (EEPROM_SIMULATED_COUNTERS)
+#define EEPROM_Read(address) EEPROM_SimulatedRead((address))
+#define EEPROM_ReadBlock(data, address, len) EEPROM_SimulatedReadBlock((data), (address), (len))
+#define EEPROM_Write(address, data) EEPROM_SimulatedWrite((address), (data))
+#else // EEPROM_SIMULATED_COUNTERS
+#define EEPROM_Read(address) EE_STATE.memory[(address)]
+#define EEPROM_ReadBlock(data, address, len) memcpy((data), &EE_STATE.memory[(address)], (len))
+#define EEPROM_Write(address, data) EE_STATE.memory[(address)] = (data)
+#endif // EEPROM_SIMULATED_COUNTERS
+#else // EEPROM_BACKEND
+// The simulated external EEPROM, or FRAM
+uint8_t EEPROM_BackendRead(const uint16_t address) {
+#if (EEPROM_SIMULATED_COUNTERS)
+  ++EE_STATE.stats.reads;
+  EE_STATE.stats.busy += EE_SIMULATED_EXTERNAL_ADDRESS_NS + EE_SIMULATED_EXTERNAL_READ_NS;
+#endif // EEPROM_SIMULATED_COUNTERS
+  return EE_STATE.memory[address];
+}
+
+void EEPROM_BackendReadBlock(void *data, const uint16_t address, const uint16_t len) {
+#if (EEPROM_SIMULATED_COUNTERS)
+  EE_STATE.stats.reads += len;
+  EE_STATE.stats.busy += EE_SIMULATED_EXTERNAL_ADDRESS_NS + (uint64_t)EE_SIMULATED_EXTERNAL_READ_NS * len;
+#endif // EEPROM_SIMULATED_COUNTERS
+  memcpy(data, &EE_STATE.memory[address], len);
+}
+
+void EEPROM_BackendWritePage(const uint16_t address, const void *data, const uint16_t len) {
+#if (EEPROM_SIMULATED_COUNTERS)
+  // Every byte sent in a page write is programmed, whether it changes or not
+  EE_STATE.stats.writes += len;
+  for (uint16_t i = 0; i < len; ++i)
+    ++EE_STATE.cellWrites[address + i];
+#if (EEPROM_BACKEND == 1)
+  ++EE_STATE.stats.pages;
+  EE_STATE.stats.erases += len;
+  EE_STATE.stats.busy += EE_SIMULATED_PAGE_WRITE_NS;
+  for (uint16_t i = 0; i < len; ++i)
+    ++EE_STATE.cellErases[address + i];
+#else // EEPROM_BACKEND
+  // FRAM is written as fast as the bytes are sent, and is never erased
+  EE_STATE.stats.busy += EE_SIMULATED_EXTERNAL_ADDRESS_NS + (uint64_t)EE_SIMULATED_EXTERNAL_READ_NS * len;
+#endif // EEPROM_BACKEND
+#endif // EEPROM_SIMULATED_COUNTERS
+  memcpy(&EE_STATE.memory[address], data, len);
+}
+#endif // EEPROM_BACKEND
 void EEPROM_Print(const uint16_t begin, const uint16_t end) {
   printf("-----------------------------------------------\n");
   for (uint16_t i = begin; i < end; ++i)
-    printf("%02X %s", eeprom[i], (i + 1) % 16 ? "" : "\n");
+    printf("%02X %s", EE_STATE.memory[i], (i + 1) % 16 ? "" : "\n");
   printf("-----------------------------------------------\n");
 }
+
+uint8_t (*EEPROM_SimulatedMemory(void))[EEPROM_SIMULATED_SIZE] {
+  return &EE_STATE.memory;
+}
+
+EEPROM_Instance *EEPROM_CreateInstance(void) {
+  EEPROM_Instance *instance = calloc(1, sizeof(*instance));
+  if (instance)
+    memset(instance->memory, 0xFF, sizeof(instance->memory));
+  return instance;
+}
+
+void EEPROM_DestroyInstance(EEPROM_Instance *instance) {
+  if (instance == EeSelectedState)
+    EeSelectedState = &EeDefaultState;
+  free(instance);
+}
+
+void EEPROM_SelectInstance(EEPROM_Instance *instance) {
+  EeSelectedState = instance ? instance : &EeDefaultState;
+}
+#endif // F_CPU
+
+#if (EEPROM_BACKEND && (EEPROM_WRITE_QUEUE_SIZE || EEPROM_SPLIT_PROGRAMMING || EEPROM_SLEEP_WHILE_PROGRAMMING))
+#error "EEPROM_WRITE_QUEUE_SIZE, EEPROM_SPLIT_PROGRAMMING and EEPROM_SLEEP_WHILE_PROGRAMMING require EEPROM_BACKEND = 0"
+#endif // EEPROM_BACKEND && (EEPROM_WRITE_QUEUE_SIZE || EEPROM_SPLIT_PROGRAMMING || EEPROM_SLEEP_WHILE_PROGRAMMING)
+#if (EEPROM_BACKEND == 2 && EEPROM_CACHE_SIZE)
+#error "EEPROM_CACHE_SIZE requires EEPROM_BACKEND to be 0 or 1, since FRAM has no levels to cache"
+#endif // EEPROM_BACKEND == 2 && EEPROM_CACHE_SIZE
+
+#if (EEPROM_BACKEND == 1)
+#if (EEPROM_PAGE_SIZE < 1 || (EEPROM_PAGE_SIZE & (EEPROM_PAGE_SIZE - 1)))
+#error "EEPROM_PAGE_SIZE must be a power of two"
+#endif // EEPROM_PAGE_SIZE
+/*
+Writes to an external EEPROM are collected into a page buffer, and
+only sent once a write is made to an address that does not continue
+the collected run of bytes within the same page, or when
+EEPROM_FlushPage is called, so that consecutive bytes of a page are
+written in a single write cycle. Bytes that were not written are never
+sent, since a page write programs every byte it is given. */
+static void EEPROM_FlushPage(void) {
+  if (EE_STATE.pageLength) {
+    EEPROM_BackendWritePage(EE_STATE.pageAddress, EE_STATE.pageData, EE_STATE.pageLength);
+    EE_STATE.pageLength = 0;
+  }
+}
+
+static void EEPROM_PageWrite(const uint16_t address, const uint8_t data) {
+  if (EE_STATE.pageLength && (address < EE_STATE.pageAddress ||
+      address > EE_STATE.pageAddress + EE_STATE.pageLength ||
+      (address & ~(uint16_t)(EEPROM_PAGE_SIZE - 1)) != (EE_STATE.pageAddress & ~(uint16_t)(EEPROM_PAGE_SIZE - 1))))
+    EEPROM_FlushPage();
+
+  if (!EE_STATE.pageLength)
+    EE_STATE.pageAddress = address;
+
+  uint16_t index = address - EE_STATE.pageAddress;
+  EE_STATE.pageData[index] = data;
+  if (index == EE_STATE.pageLength)
+    ++EE_STATE.pageLength;
+}
+
+// Returns the contents of a byte, including any write that has not yet been sent
+static uint8_t EEPROM_PageRead(const uint16_t address) {
+  uint16_t index = address - EE_STATE.pageAddress;
+  if (index < EE_STATE.pageLength)
+    return EE_STATE.pageData[index];
+  return EEPROM_BackendRead(address);
+}
+
+static inline void EEPROM_PageReadBlock(void *data, const uint16_t address, const uint16_t len) {
+  EEPROM_FlushPage();
+  EEPROM_BackendReadBlock(data, address, len);
+}
+
+#define EEPROM_Read(address) EEPROM_PageRead((address))
+#define EEPROM_ReadBlock(data, address, len) EEPROM_PageReadBlock((data), (address), (len))
+#define EEPROM_Write(address, data) EEPROM_PageWrite((address), (data))
+#elif (EEPROM_BACKEND == 2)
+static inline void EEPROM_FramWrite(const uint16_t address, const uint8_t data) {
+  EEPROM_BackendWritePage(address, &data, 1);
+}
+
+#define EEPROM_Read(address) EEPROM_BackendRead((address))
+#define EEPROM_ReadBlock(data, address, len) EEPROM_BackendReadBlock((data), (address), (len))
+#define EEPROM_Write(address, data) EEPROM_FramWrite((address), (data))
+#endif // EEPROM_BACKEND
+#if (EEPROM_BACKEND != 1)
+// Every write is performed immediately
+#define EEPROM_FlushPage() do { } while (0)
+#endif // EEPROM_BACKEND
+
+#if (EEPROM_WRITE_QUEUE_SIZE)
+#if (EEPROM_WRITE_QUEUE_SIZE > 255)
+#error "EEPROM_WRITE_QUEUE_SIZE must not be larger than 255"
+#endif // EEPROM_WRITE_QUEUE_SIZE
+// The simulated EEPROM is never busy, so queued writes are only
+// performed when serviced
+
+/*
+Starts the oldest queued write, if the EEPROM is ready, skipping any
+queued writes that would not change the contents of the EEPROM. This
+must only be called with interrupts disabled. */
+static void EEPROM_ServiceQueue(void) {
+#ifdef F_CPU
+  while (EE_STATE.queueCount && !(EECR & _BV(EEPE))) {
+#else // F_CPU
+  if (EE_STATE.queueCount) {
+#endif // F_CPU
+    uint16_t address = EE_STATE.queueAddress[EE_STATE.queueHead];
+    uint8_t data = EE_STATE.queueData[EE_STATE.queueHead];
+    if (++EE_STATE.queueHead == EEPROM_WRITE_QUEUE_SIZE)
+      EE_STATE.queueHead = 0;
+    --EE_STATE.queueCount;
+
+#ifdef F_CPU
+    EEAR = address;
+    EECR |= _BV(EERE);
+    if (EEDR != data) {
+#if (EEPROM_SPLIT_PROGRAMMING)
+      EECR = (EECR & ~(_BV(EEPM1) | _BV(EEPM0))) | EEPROM_ProgrammingMode(EEDR, data);
+#endif // EEPROM_SPLIT_PROGRAMMING
+      EEDR = data;
+      EECR |= _BV(EEMPE);
+      EECR |= _BV(EEPE);
+    }
+#else // F_CPU
+    EEPROM_Write(address, data);
+#endif // F_CPU
+  }
+
+#ifdef F_CPU
+  // Stop requesting interrupts once there is nothing left to write
+  if (!EE_STATE.queueCount)
+    EECR &= ~_BV(EERIE);
+#endif // F_CPU
+}
+
+#ifdef F_CPU
+ISR(EE_READY_VECTOR) {
+  EEPROM_ServiceQueue();
+}
+#endif // F_CPU
+
+// Returns the index of the ring buffer entry that is i entries after head
+static uint8_t EEPROM_QueueIndex(const uint8_t head, const uint8_t i) {
+  uint16_t index = (uint16_t)head + i;
+  if (index >= EEPROM_WRITE_QUEUE_SIZE)
+    index -= EEPROM_WRITE_QUEUE_SIZE;
+  return index;
+}
+
+static uint8_t EEPROM_QueueRead(const uint16_t address) {
+  uint8_t head;
+  uint8_t count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    head = EE_STATE.queueHead;
+    count = EE_STATE.queueCount;
+  }
+
+  /*
+  The queue is searched with interrupts enabled. Entries are only
+  added by the caller, and only removed by the EEPROM Ready interrupt
+  as their writes are started, so every entry found still holds the
+  current value of its address. The most recently queued write to an
+  address holds its value. */
+  for (uint8_t i = count; i-- != 0; ) {
+    uint8_t index = EEPROM_QueueIndex(head, i);
+    if (EE_STATE.queueAddress[index] == address)
+      return EE_STATE.queueData[index];
+  }
+
+  uint8_t data = 0;
+  uint8_t done = 0;
+  do {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#ifdef F_CPU
+      // The EEPROM cannot be read while a write is in progress
+      if (!done && !(EECR & _BV(EEPE))) {
+        EEAR = address;
+        EECR |= _BV(EERE);
+        data = EEDR;
+        done = 1;
+      }
+#else // F_CPU
+      if (!done) {
+        data = EEPROM_Read(address);
+        done = 1;
+      }
+#endif // F_CPU
+    }
+#if (defined(F_CPU) && EEPROM_SLEEP_WHILE_PROGRAMMING)
+    if (!done)
+      EEPROM_SleepWhileBusy();
+#endif // F_CPU && EEPROM_SLEEP_WHILE_PROGRAMMING
+  } while (!done);
+  return data;
+}
+
+static void EEPROM_QueueWrite(const uint16_t address, const uint8_t data) {
+  uint8_t done = 0;
+  do {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      // Try to make room, in case interrupts had been disabled
+      if (EE_STATE.queueCount == EEPROM_WRITE_QUEUE_SIZE)
+        EEPROM_ServiceQueue();
+
+      if (EE_STATE.queueCount != EEPROM_WRITE_QUEUE_SIZE) {
+        uint8_t index = EEPROM_QueueIndex(EE_STATE.queueHead, EE_STATE.queueCount);
+        EE_STATE.queueAddress[index] = address;
+        EE_STATE.queueData[index] = data;
+        ++EE_STATE.queueCount;
+        done = 1;
+#ifdef F_CPU
+        EECR |= _BV(EERIE);
+#endif // F_CPU
+      }
+    }
+#if (defined(F_CPU) && EEPROM_SLEEP_WHILE_PROGRAMMING)
+    // The queue is full, and the next write starts once this one is done
+    if (!done)
+      EEPROM_SleepWhileBusy();
+#endif // F_CPU && EEPROM_SLEEP_WHILE_PROGRAMMING
+  } while (!done);
+}
+
+uint8_t EEPROM_PendingWrites(void) {
+  return EE_STATE.queueCount;
+}
+
+uint8_t EEPROM_PollWrites(void) {
+  uint8_t pending;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    EEPROM_ServiceQueue();
+    pending = EE_STATE.queueCount;
+  }
+  return pending;
+}
+
+void EEPROM_FlushWrites(void) {
+  while (EEPROM_PollWrites()) {
+#if (defined(F_CPU) && EEPROM_SLEEP_WHILE_PROGRAMMING)
+    EEPROM_SleepWhileBusy();
+#endif // F_CPU && EEPROM_SLEEP_WHILE_PROGRAMMING
+  }
+#ifdef F_CPU
+  EEPROM_BusyWait();
+#endif // F_CPU
+}
+
+static inline void EEPROM_QueueReadBlock(uint8_t *data, const uint16_t address, const uint16_t len) {
+  for (uint16_t i = 0; i < len; ++i)
+    data[i] = EEPROM_QueueRead(address + i);
+}
+
+#undef EEPROM_Read
+#undef EEPROM_ReadBlock
+#undef EEPROM_Write
+#define EEPROM_Read(address) EEPROM_QueueRead((address))
+#define EEPROM_ReadBlock(data, address, len) EEPROM_QueueReadBlock((data), (address), (len))
+#define EEPROM_Write(address, data) EEPROM_QueueWrite((address), (data))
+#endif // EEPROM_WRITE_QUEUE_SIZE
+
+#if (EEPROM_CACHE_SIZE)
+#if (EEPROM_CACHE_SIZE > 255)
+#error "EEPROM_CACHE_SIZE must not be larger than 255"
+#endif // EEPROM_CACHE_SIZE
+// Returns the cache entry for status, or the number of entries if it isn't cached
+static uint8_t EEPROM_CacheFind(const uint16_t status) {
+  uint8_t i;
+  for (i = 0; i < EE_STATE.cacheCount; ++i)
+    if (EE_STATE.cacheStatus[i] == status)
+      break;
+  return i;
+}
+
+// Records the current level of status, if there is room to do so
+static void EEPROM_CacheStore(const uint16_t status, const EEPROM_Level level) {
+  uint8_t i = EEPROM_CacheFind(status);
+  if (i == EE_STATE.cacheCount) {
+    if (EE_STATE.cacheCount == EEPROM_CACHE_SIZE)
+      return;
+    EE_STATE.cacheStatus[EE_STATE.cacheCount++] = status;
+  }
+  EE_STATE.cacheLevel[i] = level;
+}
+
+void EEPROM_InvalidateCache(void) {
+  EE_STATE.cacheCount = 0;
+}
+#endif // EEPROM_CACHE_SIZE
+
+#if (EEPROM_PROFILING)
+#ifdef F_CPU
+#ifndef EEPROM_PROFILE_TIMER
+#error "EEPROM_PROFILING requires EEPROM_PROFILE_TIMER to be set to a free running 16-bit timer"
+#endif // EEPROM_PROFILE_TIMER
+#define EE_PROFILE_NOW() ((uint16_t)(EEPROM_PROFILE_TIMER))
+#else // F_CPU
+#include <time.h>
+static uint16_t EEPROM_ProfileNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint16_t)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+#define EE_PROFILE_NOW() EEPROM_ProfileNow()
 #endif // F_CPU
 
-static uint16_t EEPROM_FindCurrentAddress(const uint16_t param) {
-  uint16_t EeBufPtr = param + EE_PARAM_BUFFER_SIZE; // point to the status buffer
-  uint16_t EeBufEnd = EeBufPtr + EE_STATUS_BUFFER_SIZE; // the first address outside the buffer
+// Every write made from here on is noted, so that a call to a write
+// function that leaves the EEPROM untouched is counted as skipped. The
+// internal EEPROM is only written where a byte changes, so a write of
+// the value already stored there is not noted.
+static inline void EEPROM_ProfiledWrite(const uint16_t address, const uint8_t data) {
+#if (EEPROM_BACKEND == 0)
+  if (EEPROM_Read(address) != data)
+#endif // EEPROM_BACKEND
+    EE_STATE.profileWritten = 1;
+  EEPROM_Write(address, data);
+}
+#undef EEPROM_Write
+#define EEPROM_Write(address, data) EEPROM_ProfiledWrite((address), (data))
+
+/*
+Only the outermost of nested calls is measured, such as an increment
+of a counter that writes the block holding its number of rollovers. */
+static uint16_t EEPROM_ProfileBegin(void) {
+  if (EE_STATE.profileDepth++ == 0)
+    EE_STATE.profileWritten = 0;
+  return EE_PROFILE_NOW();
+}
+
+static void EEPROM_ProfileEnd(const uint8_t api, const uint16_t begin, const uint8_t write) {
+  uint16_t ticks = (uint16_t)(EE_PROFILE_NOW() - begin);
+  if (--EE_STATE.profileDepth)
+    return;
+
+  EEPROM_ProfileStats *stats = &EE_STATE.profile[api];
+  if (!stats->calls || ticks < stats->min)
+    stats->min = ticks;
+  if (ticks > stats->max)
+    stats->max = ticks;
+  stats->total += ticks;
+  ++stats->calls;
+  if (write && !EE_STATE.profileWritten)
+    ++stats->skipped;
+}
+
+void EEPROM_GetProfileStats(const uint8_t api, EEPROM_ProfileStats *stats) {
+  *stats = EE_STATE.profile[api];
+}
+
+void EEPROM_ResetProfileStats(void) {
+  for (uint8_t i = 0; i < EE_PROFILE_COUNT; ++i)
+    EE_STATE.profile[i] = (EEPROM_ProfileStats){ 0 };
+}
+
+#define EE_PROFILE_BEGIN() uint16_t eeProfileBegin = EEPROM_ProfileBegin()
+#define EE_PROFILE_END(api, write) EEPROM_ProfileEnd((api), eeProfileBegin, (write))
+#define EE_PROFILE_WRITTEN() (EE_STATE.profileWritten = 1)
+#else // EEPROM_PROFILING
+#define EE_PROFILE_BEGIN()
+#define EE_PROFILE_END(api, write)
+#define EE_PROFILE_WRITTEN()
+#endif // EEPROM_PROFILING
+
+#if (EEPROM_BACKEND != 2)
+/*
+EE_STATUS_AT gives the value of an element of a status buffer written
+in the same rotation as the first element, EE_STATUS_NEXT gives the
+value written into the element of a level that becomes current, and
+EE_STATUS_INIT gives the initial value of each element, which makes
+the first level current. */
+#if (EEPROM_BIT_CLEARING_STATUS)
+/*
+Every element of a status buffer holds the number of times its level
+has been written, modulo 9, as a run of cleared bits starting from
+the lowest bit (0xFF, 0xFE, 0xFC, ..., 0x00, and back to 0xFF). The
+elements up to, and including, the last written element share the
+same value, and every element after it holds the value one less, so
+writing the next level only clears one more bit of its element, and
+only the first element is advanced when the buffer wraps around. */
+#define EE_STATUS_AT(first, index) (first)
+#define EE_STATUS_NEXT(previous, level) \
+  ((level) ? (previous) : (previous) ? (uint8_t)((previous) << 1) : 0xFF)
+#define EE_STATUS_INIT(index, levels) ((index) ? 0xFF : 0xFE)
+#else // EEPROM_BIT_CLEARING_STATUS
+/*
+Every element of a status buffer holds the value of the element
+before it plus one, up to, and including, the last written element,
+as described in Atmel's AVR101 application note. */
+#define EE_STATUS_AT(first, index) (uint8_t)((first) + (index))
+#define EE_STATUS_NEXT(previous, level) (uint8_t)((previous) + 1)
+#define EE_STATUS_INIT(index, levels) (uint8_t)(((index) ? (index) : (levels)) - 1)
+#endif // EEPROM_BIT_CLEARING_STATUS
+
+/*
+Returns the index of the last written element of a status buffer of
+the given number of levels, which is also the index of the level of
+the param buffer holding the current value. */
+static EEPROM_Level EEPROM_FindCurrentLevel(const uint16_t status, const EEPROM_Level levels) {
+#if (EEPROM_CACHE_SIZE)
+  uint8_t i = EEPROM_CacheFind(status);
+  if (i != EE_STATE.cacheCount)
+    return EE_STATE.cacheLevel[i];
+#endif // EEPROM_CACHE_SIZE
+
+  uint16_t EeBufPtr = status; // point to the status buffer
+
+#if (EEPROM_BINARY_SEARCH)
+  // Every element of the status buffer up to, and including, the last
+  // written element holds the value expected from the first element
+  // and its index, and every element after it does not, so the last
+  // written element can be found by bisecting the status buffer.
+  uint8_t first = EEPROM_Read(EeBufPtr);
+  EEPROM_Level low = 0;
+  EEPROM_Level high = levels - 1;
+  while (low != high) {
+    EEPROM_Level mid = low + (EEPROM_Level)(high - low + 1) / 2;
+    if (EEPROM_Read(EeBufPtr + mid) == EE_STATUS_AT(first, mid))
+      low = mid;
+    else
+      high = mid - 1;
+  }
+
+  EEPROM_Level level = low;
+#else // EEPROM_BINARY_SEARCH
+  uint16_t EeBufEnd = EeBufPtr + levels; // the first address outside the buffer
 
   // Identify the last written element of the status buffer
   uint8_t tmp;
@@ -66,84 +826,1328 @@ static uint16_t EEPROM_FindCurrentAddress(const uint16_t param) {
     tmp = EEPROM_Read(EeBufPtr);
     if (++EeBufPtr == EeBufEnd) // avoid comparing out-of-bounds
       break;
-  } while (EEPROM_Read(EeBufPtr) == (uint8_t)(tmp + 1));
+  } while (EEPROM_Read(EeBufPtr) == EE_STATUS_AT(tmp, 1));
 
-  // Return the last used element of the param buffer
-  return EeBufPtr - (EE_PARAM_BUFFER_SIZE + 1);
+  EEPROM_Level level = EeBufPtr - (status + 1);
+#endif // EEPROM_BINARY_SEARCH
+
+#if (EEPROM_CACHE_SIZE)
+  EEPROM_CacheStore(status, level);
+#endif // EEPROM_CACHE_SIZE
+
+  return level;
 }
 
-#if (EEPROM_INCLUDE_BYTE_FUNCS == 0)
-static
-#endif // EEPROM_INCLUDE_BYTE_FUNCS
-uint8_t EEPROM_InitWearLeveledByte(const uint16_t param, const uint8_t data) {
-  EEPROM_Write(param + EE_PARAM_BUFFER_SIZE, EE_STATUS_BUFFER_SIZE - 1);
+// Writes the initial metadata into the status buffer of a segment
+static void EEPROM_InitStatusBuffer(const uint16_t status, const EEPROM_Level levels) {
+  for (EEPROM_Level i = 0; i < levels; ++i)
+    EEPROM_Write(i + status, EE_STATUS_INIT(i, levels));
+
+#if (EEPROM_CACHE_SIZE)
+  EEPROM_CacheStore(status, 0);
+#endif // EEPROM_CACHE_SIZE
+}
+
+#ifndef F_CPU
+void EEPROM_AnalyzeStatusBuffer(const uint8_t *status, const EEPROM_Level levels, EEPROM_StatusAnalysis *analysis) {
+  // Every element after the last written element holds the value it
+  // was given in the rotation before the one of the first element
+  uint8_t first = status[0];
+#if (EEPROM_BIT_CLEARING_STATUS)
+  uint8_t previous = (first == 0xFF) ? 0x00 : (uint8_t)((first >> 1) | 0x80);
+#else // EEPROM_BIT_CLEARING_STATUS
+  uint8_t previous = (uint8_t)(first - levels);
+#endif // EEPROM_BIT_CLEARING_STATUS
+
+  // Count the elements of each rotation, and find the first element
+  // that is not of the current rotation, without branching or exiting
+  // early, so that the loop is vectorized
+  EEPROM_Level current = 0;
+  EEPROM_Level matched = 0;
+  EEPROM_Level erased = 0;
+  EEPROM_Level end = levels;
+  for (EEPROM_Level i = 0; i < levels; ++i) {
+    uint8_t isCurrent = (status[i] == EE_STATUS_AT(first, i));
+    uint8_t isPrevious = (status[i] == EE_STATUS_AT(previous, i));
+    current += isCurrent;
+    matched += isCurrent | isPrevious;
+    erased += (status[i] == 0xFF);
+    EEPROM_Level candidate = isCurrent ? levels : i;
+    end = (candidate < end) ? candidate : end;
+  }
 
-  for (uint8_t i = 1; i < EE_STATUS_BUFFER_SIZE; ++i)
-    EEPROM_Write(i + param + EE_PARAM_BUFFER_SIZE, i - 1);
+  // The elements of the current rotation must all precede the others
+  if (erased == levels)
+    analysis->state = EE_STATUS_BLANK;
+  else if (matched != levels || current != end)
+    analysis->state = EE_STATUS_CORRUPT;
+  else
+    analysis->state = EE_STATUS_VALID;
+  analysis->level = end - 1;
 
+#if (EEPROM_BIT_CLEARING_STATUS)
+  // The first element has one more bit cleared for each rotation,
+  // starting with one, modulo 9
+  uint8_t rotations = (uint8_t)((16 - __builtin_popcount(first)) % 9);
+  analysis->period = (uint32_t)9 * levels;
+  analysis->writes = (uint32_t)rotations * levels + analysis->level;
+#else // EEPROM_BIT_CLEARING_STATUS
+  // The last written element starts at levels - 1, and is one more
+  // than the element before it for every write
+  analysis->period = 256;
+  analysis->writes = (uint8_t)(status[analysis->level] - levels + 1);
+#endif // EEPROM_BIT_CLEARING_STATUS
+}
+#endif // F_CPU
+#endif // EEPROM_BACKEND
+
+/*
+The functions that take the number of levels of a segment are only
+visible outside of this file when EEPROM_PER_PARAMETER_LEVELS is set.
+Otherwise, they are only ever passed EEPROM_WEAR_LEVEL_FACTOR, which
+the compiler propagates into them as a constant. */
+#if (EEPROM_PER_PARAMETER_LEVELS)
+#define EE_LEVELS_LINKAGE
+#else // EEPROM_PER_PARAMETER_LEVELS
+#define EE_LEVELS_LINKAGE static
+#endif // EEPROM_PER_PARAMETER_LEVELS
+
+#if (EEPROM_BACKEND == 2)
+/*
+FRAM does not wear out, so every parameter is stored exactly once,
+without any metadata, and is read and written directly. The number of
+levels is ignored, and every segment is the size of its data. */
+#if (EEPROM_INCLUDE_BYTE_FUNCS)
+EE_LEVELS_LINKAGE
+uint8_t EEPROM_InitWearLeveledByteN(const uint16_t param, const uint8_t data, const EEPROM_Level levels) {
+  (void)levels;
   EEPROM_Write(param, data);
   return data;
 }
 
-#if (EEPROM_INCLUDE_BYTE_FUNCS == 0)
-static
-#endif // EEPROM_INCLUDE_BYTE_FUNCS
-uint8_t EEPROM_ReadWearLeveledByte(const uint16_t param) {
-  return EEPROM_Read(EEPROM_FindCurrentAddress(param));
+EE_LEVELS_LINKAGE
+uint8_t EEPROM_ReadWearLeveledByteN(const uint16_t param, const EEPROM_Level levels) {
+  (void)levels;
+  return EEPROM_Read(param);
 }
 
-#if (EEPROM_INCLUDE_BYTE_FUNCS == 0)
-static
+EE_LEVELS_LINKAGE
+void EEPROM_WriteWearLeveledByteN(const uint16_t param, const uint8_t data, const EEPROM_Level levels) {
+  (void)levels;
+  EEPROM_Write(param, data);
+}
 #endif // EEPROM_INCLUDE_BYTE_FUNCS
-void EEPROM_WriteWearLeveledByte(const uint16_t param, const uint8_t data) {
-  uint16_t address = EEPROM_FindCurrentAddress(param);
+#elif (EEPROM_INCLUDE_BYTE_FUNCS || !EEPROM_ROTATE_WHOLE_BLOCKS)
+static inline void EEPROM_InitByte(const uint16_t param, const uint8_t data, const EEPROM_Level levels) {
+  EEPROM_InitStatusBuffer(param + levels, levels);
+  EEPROM_Write(param, data);
+}
+
+// The steps of writing a new value of a byte, which are performed
+// separately for every byte of a block written to an external EEPROM
+#define EE_WRITE_DATA  1
+#define EE_WRITE_STATUS  2
+
+// Returns whether the status buffer was updated to wrap around to the
+// first level, completing a rotation through every level
+static inline uint8_t EEPROM_WriteByte(const uint16_t param, const uint8_t data, const EEPROM_Level levels, const uint8_t steps) {
+  EEPROM_Level level = EEPROM_FindCurrentLevel(param + levels, levels);
+  uint16_t address = param + level;
 
   // Only perform the write if the new value is different from what's currently stored
   if (EEPROM_Read(address) == data)
-    return;
+    return 0;
 
   // Store the old status value
-  uint8_t oldStatusValue = EEPROM_Read(address + EE_PARAM_BUFFER_SIZE);
+  uint8_t oldStatusValue = (steps & EE_WRITE_STATUS) ? EEPROM_Read(address + levels) : 0;
 
   // Move pointer to the next element in the buffer, wrapping around if necessary
-  if (++address == param + EE_PARAM_BUFFER_SIZE)
+  if (++level == levels) {
+    level = 0;
     address = param;
+  } else {
+    ++address;
+  }
 
   // If self-programming is used in the application, insert code here
   // to wait for any self-programming operations to finish before
   // writing to the EEPROM.
 
+  if (steps & EE_WRITE_DATA) {
+    // Update the param buffer in the EEPROM
+    EEPROM_Write(address, data);
+    // The new value must be written before the status buffer is updated
+    if (steps & EE_WRITE_STATUS)
+      EEPROM_FlushPage();
+  }
+
+  if (steps & EE_WRITE_STATUS) {
+    // Update the status buffer in the EEPROM
+    EEPROM_Write(address + levels, EE_STATUS_NEXT(oldStatusValue, level));
+
+#if (EEPROM_CACHE_SIZE)
+    EEPROM_CacheStore(param + levels, level);
+#endif // EEPROM_CACHE_SIZE
+    return !level;
+  }
+  return 0;
+}
+
+#if (EEPROM_INCLUDE_BYTE_FUNCS)
+EE_LEVELS_LINKAGE
+uint8_t EEPROM_InitWearLeveledByteN(const uint16_t param, const uint8_t data, const EEPROM_Level levels) {
+  EEPROM_InitByte(param, data, levels);
+  EEPROM_FlushPage();
+  return data;
+}
+#endif // EEPROM_INCLUDE_BYTE_FUNCS
+
+#if (EEPROM_INCLUDE_BYTE_FUNCS == 0)
+static
+#else // EEPROM_INCLUDE_BYTE_FUNCS
+EE_LEVELS_LINKAGE
+#endif // EEPROM_INCLUDE_BYTE_FUNCS
+uint8_t EEPROM_ReadWearLeveledByteN(const uint16_t param, const EEPROM_Level levels) {
+  return EEPROM_Read(param + EEPROM_FindCurrentLevel(param + levels, levels));
+}
+
+#if (EEPROM_INCLUDE_BYTE_FUNCS)
+EE_LEVELS_LINKAGE
+void EEPROM_WriteWearLeveledByteN(const uint16_t param, const uint8_t data, const EEPROM_Level levels) {
+  EEPROM_WriteByte(param, data, levels, EE_WRITE_DATA | EE_WRITE_STATUS);
+  EEPROM_FlushPage();
+}
+#endif // EEPROM_INCLUDE_BYTE_FUNCS
+#endif // EEPROM_BACKEND == 2, EEPROM_INCLUDE_BYTE_FUNCS || !EEPROM_ROTATE_WHOLE_BLOCKS
+
+#if (EEPROM_INCLUDE_BYTE_FUNCS)
+uint8_t EEPROM_InitWearLeveledByte(const uint16_t param, const uint8_t data) {
+  return EEPROM_InitWearLeveledByteN(param, data, EE_PARAM_BUFFER_SIZE);
+}
+
+uint8_t EEPROM_ReadWearLeveledByte(const uint16_t param) {
+  EE_PROFILE_BEGIN();
+  uint8_t data = EEPROM_ReadWearLeveledByteN(param, EE_PARAM_BUFFER_SIZE);
+  EE_PROFILE_END(EE_PROFILE_READ_BYTE, 0);
+  return data;
+}
+
+void EEPROM_WriteWearLeveledByte(const uint16_t param, const uint8_t data) {
+  EE_PROFILE_BEGIN();
+  EEPROM_WriteWearLeveledByteN(param, data, EE_PARAM_BUFFER_SIZE);
+  EE_PROFILE_END(EE_PROFILE_WRITE_BYTE, 1);
+}
+#endif // EEPROM_INCLUDE_BYTE_FUNCS
+
+#if (EEPROM_DEFERRED_WRITES)
+#if (EEPROM_INCLUDE_BYTE_FUNCS == 0)
+#error "EEPROM_DEFERRED_WRITES requires EEPROM_INCLUDE_BYTE_FUNCS = 1"
+#endif // EEPROM_INCLUDE_BYTE_FUNCS
+#if (EEPROM_DEFERRED_WRITES > 255)
+#error "EEPROM_DEFERRED_WRITES must not be larger than 255"
+#endif // EEPROM_DEFERRED_WRITES
+/*
+Interrupt handlers never run the wear-leveling functions, which are
+not reentrant, and only add writes to this ring buffer, with
+interrupts disabled for the few cycles that takes. */
+uint8_t EEPROM_DeferWearLeveledByte(const uint16_t param, const uint8_t data) {
+  uint8_t deferred = 0;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (EE_STATE.deferredCount != EEPROM_DEFERRED_WRITES) {
+      uint16_t index = (uint16_t)EE_STATE.deferredHead + EE_STATE.deferredCount;
+      if (index >= EEPROM_DEFERRED_WRITES)
+        index -= EEPROM_DEFERRED_WRITES;
+      EE_STATE.deferredParam[index] = param;
+      EE_STATE.deferredData[index] = data;
+      ++EE_STATE.deferredCount;
+      deferred = 1;
+    }
+  }
+  return deferred;
+}
+
+void EEPROM_ApplyDeferredWrites(void) {
+  for (;;) {
+    uint16_t param = 0;
+    uint8_t data = 0;
+    uint8_t pending = 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      if (EE_STATE.deferredCount) {
+        param = EE_STATE.deferredParam[EE_STATE.deferredHead];
+        data = EE_STATE.deferredData[EE_STATE.deferredHead];
+        if (++EE_STATE.deferredHead == EEPROM_DEFERRED_WRITES)
+          EE_STATE.deferredHead = 0;
+        --EE_STATE.deferredCount;
+        pending = 1;
+      }
+    }
+    if (!pending)
+      break;
+    EEPROM_WriteWearLeveledByte(param, data);
+  }
+}
+#endif // EEPROM_DEFERRED_WRITES
+
+#if (EEPROM_BACKEND != 2 && ((EEPROM_INCLUDE_BLOCK_FUNCS && EEPROM_ROTATE_WHOLE_BLOCKS) || EEPROM_INCLUDE_VERSIONED_BLOCK_FUNCS || EEPROM_INCLUDE_COUNTER_FUNCS))
+/*
+When whole blocks are rotated, for every versioned block, and for the
+number of rollovers of every counter, each level of the param buffer
+holds a complete copy of the block, and a single status buffer,
+located after the last level, keeps track of which copy is current:
+
+  [level 0: len bytes][level 1: len bytes]...[status buffer]
+
+Since the status buffer is only updated after every byte of the new
+copy has been written, an interrupted write leaves the previous copy
+of the block intact. */
+static void EEPROM_InitRotatedBlock(const uint16_t param, const void *data, const uint16_t len, const EEPROM_Level levels) {
+  EEPROM_InitStatusBuffer(param + levels * len, levels);
+
+  for (uint16_t i = 0; i < len; ++i)
+    EEPROM_Write(param + i, *(((uint8_t *)data) + i));
+  EEPROM_FlushPage();
+}
+
+static void EEPROM_ReadRotatedBlock(const uint16_t param, void *data, const uint16_t len, const EEPROM_Level levels) {
+  // The current copy is contiguous, so it is read in a single burst
+  EEPROM_ReadBlock(data, param + EEPROM_FindCurrentLevel(param + levels * len, levels) * len, len);
+}
+
+// Returns whether the status buffer was updated to wrap around to the
+// first level
+static uint8_t EEPROM_WriteRotatedBlock(const uint16_t param, const void *data, const uint16_t len, const EEPROM_Level levels) {
+  uint16_t status = param + levels * len;
+  EEPROM_Level level = EEPROM_FindCurrentLevel(status, levels);
+  uint16_t address = param + level * len;
+
+  // Only perform the write if the new block is different from what's currently stored
+  uint16_t i;
+  for (i = 0; i < len; ++i)
+    if (EEPROM_Read(address + i) != *(((uint8_t *)data) + i))
+      break;
+  if (i == len)
+    return 0;
+
+  // Store the old status value
+  uint8_t oldStatusValue = EEPROM_Read(status + level);
+
+  // Move pointer to the next level in the buffer, wrapping around if necessary
+  if (++level == levels) {
+    level = 0;
+    address = param;
+  } else {
+    address += len;
+  }
+
   // Update the param buffer in the EEPROM
-  EEPROM_Write(address, data);
+  for (i = 0; i < len; ++i)
+    EEPROM_Write(address + i, *(((uint8_t *)data) + i));
+  EEPROM_FlushPage();
 
   // Update the status buffer in the EEPROM
-  EEPROM_Write(address + EE_PARAM_BUFFER_SIZE, oldStatusValue + 1);
+  EEPROM_Write(status + level, EE_STATUS_NEXT(oldStatusValue, level));
+  EEPROM_FlushPage();
+
+#if (EEPROM_CACHE_SIZE)
+  EEPROM_CacheStore(status, level);
+#endif // EEPROM_CACHE_SIZE
+  return !level;
 }
+#endif // EEPROM_BACKEND != 2 && ((EEPROM_INCLUDE_BLOCK_FUNCS && EEPROM_ROTATE_WHOLE_BLOCKS) || EEPROM_INCLUDE_VERSIONED_BLOCK_FUNCS || EEPROM_INCLUDE_COUNTER_FUNCS)
 
 #if (EEPROM_INCLUDE_BLOCK_FUNCS)
-void EEPROM_InitWearLeveledBlock(const uint16_t param, const void *data, const uint16_t len) {
+// Whether a byte of a block differs from the copy of the block known
+// to be stored, which is assumed whenever there is no such copy
+#define EE_BYTE_CHANGED(data, previous, i) \
+  (!(previous) || ((const uint8_t *)(data))[(i)] != ((const uint8_t *)(previous))[(i)])
+
+#if (EEPROM_BACKEND == 2)
+EE_LEVELS_LINKAGE
+void EEPROM_InitWearLeveledBlockN(const uint16_t param, const void *data, const uint16_t len, const EEPROM_Level levels) {
+  (void)levels;
+  if (len)
+    EEPROM_BackendWritePage(param, data, len);
+}
+
+EE_LEVELS_LINKAGE
+void EEPROM_ReadWearLeveledBlockN(const uint16_t param, void *data, const uint16_t len, const EEPROM_Level levels) {
+  (void)levels;
+  EEPROM_ReadBlock(data, param, len);
+}
+
+EE_LEVELS_LINKAGE
+void EEPROM_WriteWearLeveledBlockN(const uint16_t param, const void *data, const uint16_t len, const EEPROM_Level levels) {
+  (void)levels;
+  if (len) {
+    EEPROM_BackendWritePage(param, data, len);
+    EE_PROFILE_WRITTEN();
+  }
+}
+
+EE_LEVELS_LINKAGE
+void EEPROM_UpdateWearLeveledBlockN(const uint16_t param, const void *data, const void *previous, const uint16_t len, const EEPROM_Level levels) {
+  (void)levels;
+  // Only the bytes from the first to the last changed byte are written
+  uint16_t begin = 0;
+  uint16_t end = len;
+  while (begin != end && !EE_BYTE_CHANGED(data, previous, begin))
+    ++begin;
+  while (end != begin && !EE_BYTE_CHANGED(data, previous, end - 1))
+    --end;
+  if (begin != end) {
+    EEPROM_BackendWritePage(param + begin, ((const uint8_t *)data) + begin, end - begin);
+    EE_PROFILE_WRITTEN();
+  }
+}
+#elif (EEPROM_ROTATE_WHOLE_BLOCKS)
+EE_LEVELS_LINKAGE
+void EEPROM_InitWearLeveledBlockN(const uint16_t param, const void *data, const uint16_t len, const EEPROM_Level levels) {
+  EEPROM_InitRotatedBlock(param, data, len, levels);
+}
+
+EE_LEVELS_LINKAGE
+void EEPROM_ReadWearLeveledBlockN(const uint16_t param, void *data, const uint16_t len, const EEPROM_Level levels) {
+  EEPROM_ReadRotatedBlock(param, data, len, levels);
+}
+
+// Returns the number of times a status buffer wrapped around
+static inline uint16_t EEPROM_WriteBlock(const uint16_t param, const void *data, const void *previous, const uint16_t len, const EEPROM_Level levels) {
+  uint16_t i = 0;
+  while (i < len && !EE_BYTE_CHANGED(data, previous, i))
+    ++i;
+  if (i == len)
+    return 0;
+  return EEPROM_WriteRotatedBlock(param, data, len, levels);
+}
+#else // EEPROM_ROTATE_WHOLE_BLOCKS
+EE_LEVELS_LINKAGE
+void EEPROM_InitWearLeveledBlockN(const uint16_t param, const void *data, const uint16_t len, const EEPROM_Level levels) {
   for (uint16_t i = 0; i < len; ++i)
-    EEPROM_InitWearLeveledByte(param + i * (EE_PARAM_BUFFER_SIZE + EE_STATUS_BUFFER_SIZE),
-                               *(((uint8_t *)data) + i));
+    EEPROM_InitByte(param + i * ((uint16_t)levels * 2), *(((uint8_t *)data) + i), levels);
+  EEPROM_FlushPage();
 }
 /*
 EEPROM_ReadWearLeveledBlock() is typically only called once per
 parameter, usually when the device is first powered on, to retrieve
 the latest stored value. */
-void EEPROM_ReadWearLeveledBlock(const uint16_t param, void *data, const uint16_t len) {
+EE_LEVELS_LINKAGE
+void EEPROM_ReadWearLeveledBlockN(const uint16_t param, void *data, const uint16_t len, const EEPROM_Level levels) {
   for (uint16_t i = 0; i < len; ++i)
-    *(((uint8_t *)data) + i) = EEPROM_ReadWearLeveledByte(param + i * (EE_PARAM_BUFFER_SIZE
-								       + EE_STATUS_BUFFER_SIZE));
+    *(((uint8_t *)data) + i) = EEPROM_ReadWearLeveledByteN(param + i * ((uint16_t)levels * 2), levels);
 }
 /*
 EEPROM_WriteWearLeveledBlock() is called to store the value of a
 parameter in EEPROM. Internally, it checks to see if each byte being
 stored is different than the one currently present in EEPROM, and
 writes only occur for bytes that have changed. */
+static inline uint16_t EEPROM_WriteBlock(const uint16_t param, const void *data, const void *previous, const uint16_t len, const EEPROM_Level levels) {
+  uint16_t rotations = 0;
+#if (EEPROM_BACKEND == 1)
+  // Write every new value before updating any status buffer, so that
+  // the bytes of the block sharing a page share a page write
+  for (uint16_t i = 0; i < len; ++i)
+    if (EE_BYTE_CHANGED(data, previous, i))
+      EEPROM_WriteByte(param + i * ((uint16_t)levels * 2), *(((uint8_t *)data) + i), levels, EE_WRITE_DATA);
+  EEPROM_FlushPage();
+
+  for (uint16_t i = 0; i < len; ++i)
+    if (EE_BYTE_CHANGED(data, previous, i))
+      rotations += EEPROM_WriteByte(param + i * ((uint16_t)levels * 2), *(((uint8_t *)data) + i), levels, EE_WRITE_STATUS);
+#else // EEPROM_BACKEND
+  for (uint16_t i = 0; i < len; ++i)
+    if (EE_BYTE_CHANGED(data, previous, i))
+      rotations += EEPROM_WriteByte(param + i * ((uint16_t)levels * 2), *(((uint8_t *)data) + i), levels, EE_WRITE_DATA | EE_WRITE_STATUS);
+#endif // EEPROM_BACKEND
+  EEPROM_FlushPage();
+  return rotations;
+}
+#endif // EEPROM_BACKEND == 2, EEPROM_ROTATE_WHOLE_BLOCKS
+
+#if (EEPROM_BACKEND != 2)
+EE_LEVELS_LINKAGE
+void EEPROM_WriteWearLeveledBlockN(const uint16_t param, const void *data, const uint16_t len, const EEPROM_Level levels) {
+  EEPROM_WriteBlock(param, data, NULL, len, levels);
+}
+
+EE_LEVELS_LINKAGE
+void EEPROM_UpdateWearLeveledBlockN(const uint16_t param, const void *data, const void *previous, const uint16_t len, const EEPROM_Level levels) {
+  EEPROM_WriteBlock(param, data, previous, len, levels);
+}
+#endif // EEPROM_BACKEND
+
+void EEPROM_InitWearLeveledBlock(const uint16_t param, const void *data, const uint16_t len) {
+  EEPROM_InitWearLeveledBlockN(param, data, len, EE_PARAM_BUFFER_SIZE);
+}
+
+void EEPROM_ReadWearLeveledBlock(const uint16_t param, void *data, const uint16_t len) {
+  EE_PROFILE_BEGIN();
+  EEPROM_ReadWearLeveledBlockN(param, data, len, EE_PARAM_BUFFER_SIZE);
+  EE_PROFILE_END(EE_PROFILE_READ_BLOCK, 0);
+}
+
 void EEPROM_WriteWearLeveledBlock(const uint16_t param, const void *data, const uint16_t len) {
+  EE_PROFILE_BEGIN();
+  EEPROM_WriteWearLeveledBlockN(param, data, len, EE_PARAM_BUFFER_SIZE);
+  EE_PROFILE_END(EE_PROFILE_WRITE_BLOCK, 1);
+}
+
+void EEPROM_UpdateWearLeveledBlock(const uint16_t param, const void *data, const void *previous, const uint16_t len) {
+  EE_PROFILE_BEGIN();
+  EEPROM_UpdateWearLeveledBlockN(param, data, previous, len, EE_PARAM_BUFFER_SIZE);
+  EE_PROFILE_END(EE_PROFILE_WRITE_BLOCK, 1);
+}
+#endif // EEPROM_INCLUDE_BLOCK_FUNCS
+
+#if (EEPROM_INCLUDE_VERSIONED_BLOCK_FUNCS)
+#if (EEPROM_BACKEND == 2)
+#error "EEPROM_INCLUDE_VERSIONED_BLOCK_FUNCS requires EEPROM_BACKEND != 2"
+#endif // EEPROM_BACKEND
+void EEPROM_InitVersionedBlock(const uint16_t param, const void *data, const uint16_t len) {
+  EEPROM_InitRotatedBlock(param, data, len, EE_PARAM_BUFFER_SIZE);
+}
+
+void EEPROM_ReadVersionedBlock(const uint16_t param, void *data, const uint16_t len) {
+  EE_PROFILE_BEGIN();
+  EEPROM_ReadRotatedBlock(param, data, len, EE_PARAM_BUFFER_SIZE);
+  EE_PROFILE_END(EE_PROFILE_READ_VERSIONED_BLOCK, 0);
+}
+
+void EEPROM_CommitVersionedBlock(const uint16_t param, const void *data, const uint16_t len) {
+  EE_PROFILE_BEGIN();
+  EEPROM_WriteRotatedBlock(param, data, len, EE_PARAM_BUFFER_SIZE);
+  EE_PROFILE_END(EE_PROFILE_COMMIT_VERSIONED_BLOCK, 1);
+}
+#endif // EEPROM_INCLUDE_VERSIONED_BLOCK_FUNCS
+
+#if (EEPROM_INCLUDE_COUNTER_FUNCS)
+#if (EEPROM_COUNTER_UNARY_SIZE < 1 || EEPROM_COUNTER_UNARY_SIZE > 255)
+#error "EEPROM_COUNTER_UNARY_SIZE must be between 1 and 255"
+#endif // EEPROM_COUNTER_UNARY_SIZE
+// The number of increments each unary area holds
+#define EE_COUNTER_UNARY_BITS ((uint16_t)EEPROM_COUNTER_UNARY_SIZE * 8)
+
+/*
+A counter is laid out as the number of rollovers, followed by two
+unary areas, the one holding the increments since the last rollover
+being selected by whether the number of rollovers is odd or even:
+
+  [rollovers][unary area 0][unary area 1]
+
+The bits of each byte of a unary area are cleared starting from the
+lowest bit, and the bytes are used in order. */
+static uint16_t EEPROM_CounterArea(const uint16_t param, const uint32_t rollovers) {
+  return param + EE_COUNTER_ROLLOVERS_SIZE + (rollovers & 1) * EEPROM_COUNTER_UNARY_SIZE;
+}
+
+#if (EEPROM_BACKEND == 2)
+/*
+Without status buffers, the number of rollovers is kept in two copies,
+followed by a byte selecting the current copy, which is only written
+once the other copy has been written in full, so an interrupted
+rollover leaves the current copy intact:
+
+  [copy 0: 4 bytes][copy 1: 4 bytes][current copy: 0 or 1] */
+#define EE_COUNTER_CURRENT_COPY(param) ((param) + 2 * sizeof(uint32_t))
+
+static void EEPROM_CounterInitRollovers(const uint16_t param, const uint32_t *rollovers) {
+  EEPROM_BackendWritePage(param, rollovers, sizeof(uint32_t));
+  EEPROM_Write(EE_COUNTER_CURRENT_COPY(param), 0);
+}
+
+static void EEPROM_CounterReadRollovers(const uint16_t param, uint32_t *rollovers) {
+  uint8_t copy = EEPROM_Read(EE_COUNTER_CURRENT_COPY(param)) & 1;
+  EEPROM_ReadBlock(rollovers, param + copy * sizeof(uint32_t), sizeof(uint32_t));
+}
+
+static void EEPROM_CounterWriteRollovers(const uint16_t param, const uint32_t *rollovers) {
+  uint8_t copy = (EEPROM_Read(EE_COUNTER_CURRENT_COPY(param)) & 1) ^ 1;
+  EEPROM_BackendWritePage(param + copy * sizeof(uint32_t), rollovers, sizeof(uint32_t));
+  EEPROM_Write(EE_COUNTER_CURRENT_COPY(param), copy);
+}
+#else // EEPROM_BACKEND
+// The number of rollovers is always kept in a rotated block, whatever
+// EEPROM_ROTATE_WHOLE_BLOCKS is set to, so that a single status write
+// commits each new number of rollovers
+static void EEPROM_CounterInitRollovers(const uint16_t param, const uint32_t *rollovers) {
+  EEPROM_InitRotatedBlock(param, rollovers, sizeof(uint32_t), EE_COUNTER_LEVELS);
+}
+
+static void EEPROM_CounterReadRollovers(const uint16_t param, uint32_t *rollovers) {
+  EEPROM_ReadRotatedBlock(param, rollovers, sizeof(uint32_t), EE_COUNTER_LEVELS);
+}
+
+static void EEPROM_CounterWriteRollovers(const uint16_t param, const uint32_t *rollovers) {
+  EEPROM_WriteRotatedBlock(param, rollovers, sizeof(uint32_t), EE_COUNTER_LEVELS);
+}
+#endif // EEPROM_BACKEND
+
+// Returns the number of cleared bits in a unary area
+static uint16_t EEPROM_CounterIncrements(const uint16_t area) {
+  uint16_t count = 0;
+  for (uint8_t i = 0; i < EEPROM_COUNTER_UNARY_SIZE; ++i) {
+    uint8_t data = EEPROM_Read(area + i);
+    if (data == 0xFF)
+      break;
+    for (; data != 0xFF; data = (data >> 1) | 0x80)
+      ++count;
+  }
+  return count;
+}
+
+// Erases every byte of a unary area that is not already erased
+static void EEPROM_CounterErase(const uint16_t area) {
+  for (uint8_t i = 0; i < EEPROM_COUNTER_UNARY_SIZE; ++i)
+    if (EEPROM_Read(area + i) != 0xFF)
+      EEPROM_Write(area + i, 0xFF);
+}
+
+// Clears the bit of a unary area that records the given increment
+static void EEPROM_CounterClearBit(const uint16_t area, const uint16_t increment) {
+  uint16_t address = area + increment / 8;
+  EEPROM_Write(address, EEPROM_Read(address) & (uint8_t)~(1 << (increment % 8)));
+}
+
+void EEPROM_InitWearLeveledCounter(const uint16_t param, const uint32_t value) {
+  uint32_t rollovers = value / EE_COUNTER_UNARY_BITS;
+  uint16_t increments = value % EE_COUNTER_UNARY_BITS;
+  EEPROM_CounterErase(EEPROM_CounterArea(param, 0));
+  EEPROM_CounterErase(EEPROM_CounterArea(param, 1));
+  EEPROM_CounterInitRollovers(param, &rollovers);
+
+  uint16_t area = EEPROM_CounterArea(param, rollovers);
+  for (uint16_t i = 0; i < increments; ++i)
+    EEPROM_CounterClearBit(area, i);
+  EEPROM_FlushPage();
+}
+
+uint32_t EEPROM_ReadWearLeveledCounter(const uint16_t param) {
+  uint32_t rollovers;
+  EEPROM_CounterReadRollovers(param, &rollovers);
+  return rollovers * EE_COUNTER_UNARY_BITS + EEPROM_CounterIncrements(EEPROM_CounterArea(param, rollovers));
+}
+
+static uint32_t EEPROM_CounterIncrement(const uint16_t param) {
+  uint32_t rollovers;
+  EEPROM_CounterReadRollovers(param, &rollovers);
+  uint16_t area = EEPROM_CounterArea(param, rollovers);
+  uint16_t increments = EEPROM_CounterIncrements(area);
+
+  if (increments == EE_COUNTER_UNARY_BITS) {
+    // Roll over into the other unary area, which must be erased before
+    // it takes over, so that the value never goes backwards. Until its
+    // first bit is cleared, the value is the same as before.
+    area = EEPROM_CounterArea(param, ++rollovers);
+    EEPROM_CounterErase(area);
+    EEPROM_FlushPage();
+    EEPROM_CounterWriteRollovers(param, &rollovers);
+    increments = 0;
+  }
+
+  EEPROM_CounterClearBit(area, increments);
+  EEPROM_FlushPage();
+  return rollovers * EE_COUNTER_UNARY_BITS + increments + 1;
+}
+
+uint32_t EEPROM_IncrementWearLeveledCounter(const uint16_t param) {
+  EE_PROFILE_BEGIN();
+  uint32_t value = EEPROM_CounterIncrement(param);
+  EE_PROFILE_END(EE_PROFILE_INCREMENT_COUNTER, 1);
+  return value;
+}
+#endif // EEPROM_INCLUDE_COUNTER_FUNCS
+
+#if (EEPROM_INCLUDE_WEAR_FUNCS)
+#if (EEPROM_INCLUDE_COUNTER_FUNCS == 0 || EEPROM_BACKEND == 2)
+#error "EEPROM_INCLUDE_WEAR_FUNCS requires EEPROM_INCLUDE_COUNTER_FUNCS = 1 and EEPROM_BACKEND != 2"
+#endif // EEPROM_INCLUDE_COUNTER_FUNCS == 0 || EEPROM_BACKEND == 2
+/*
+The status buffer of a segment only tells which level is current, so
+the number of rotations through every level, each of which erases and
+writes every byte of the segment once, is kept in a wear-leveled
+counter. Most increments of the counter clear a single bit. */
+static void EEPROM_CountRotations(const uint16_t counter, uint16_t rotations) {
+  while (rotations--)
+    EEPROM_IncrementWearLeveledCounter(counter);
+}
+
+static void EEPROM_EstimateWear(const uint16_t counter, const EEPROM_Level level, EEPROM_Wear *wear) {
+  uint32_t rotations = EEPROM_ReadWearLeveledCounter(counter);
+  wear->writes = rotations * EE_PARAM_BUFFER_SIZE + level;
+  wear->remaining = (rotations < EEPROM_ENDURANCE) ? ((uint32_t)EEPROM_ENDURANCE - rotations) * EE_PARAM_BUFFER_SIZE - level : 0;
+}
+
+#if (EEPROM_INCLUDE_BYTE_FUNCS)
+void EEPROM_WriteTrackedByte(const uint16_t param, const uint8_t data, const uint16_t counter) {
+  uint8_t rotated = EEPROM_WriteByte(param, data, EE_PARAM_BUFFER_SIZE, EE_WRITE_DATA | EE_WRITE_STATUS);
+  EEPROM_FlushPage();
+  EEPROM_CountRotations(counter, rotated);
+}
+
+void EEPROM_EstimateByteWear(const uint16_t param, const uint16_t counter, EEPROM_Wear *wear) {
+  EEPROM_EstimateWear(counter, EEPROM_FindCurrentLevel(param + EE_PARAM_BUFFER_SIZE, EE_PARAM_BUFFER_SIZE), wear);
+}
+#endif // EEPROM_INCLUDE_BYTE_FUNCS
+
+#if (EEPROM_ROTATE_WHOLE_BLOCKS)
+void EEPROM_WriteTrackedBlock(const uint16_t param, const void *data, const uint16_t len, const uint16_t counter) {
+  EEPROM_CountRotations(counter, EEPROM_WriteBlock(param, data, NULL, len, EE_PARAM_BUFFER_SIZE));
+}
+
+void EEPROM_EstimateBlockWear(const uint16_t param, const uint16_t len, const uint16_t counter, EEPROM_Wear *wear) {
+  EEPROM_EstimateWear(counter, EEPROM_FindCurrentLevel(param + EE_PARAM_BUFFER_SIZE * len, EE_PARAM_BUFFER_SIZE), wear);
+}
+#else // EEPROM_ROTATE_WHOLE_BLOCKS
+// Each byte of the block rotates on its own, so its rotations are
+// counted in a counter of its own
+void EEPROM_WriteTrackedBlock(const uint16_t param, const void *data, const uint16_t len, const uint16_t counter) {
+#if (EEPROM_BACKEND == 1 && EEPROM_WEAR_LEVEL_FACTOR > 1)
+  // Write every new value before updating any status buffer, so that
+  // the bytes of the block sharing a page share a page write. With a
+  // single level, a new value overwrites the current one, which would
+  // leave the status buffers unable to tell which bytes changed.
   for (uint16_t i = 0; i < len; ++i)
-    EEPROM_WriteWearLeveledByte(param + i * (EE_PARAM_BUFFER_SIZE + EE_STATUS_BUFFER_SIZE),
-                                *(((uint8_t *)data) + i));
+    EEPROM_WriteByte(param + i * ((uint16_t)EE_PARAM_BUFFER_SIZE * 2), *(((uint8_t *)data) + i), EE_PARAM_BUFFER_SIZE, EE_WRITE_DATA);
+  EEPROM_FlushPage();
+
+  for (uint16_t i = 0; i < len; ++i) {
+    uint8_t rotated = EEPROM_WriteByte(param + i * ((uint16_t)EE_PARAM_BUFFER_SIZE * 2), *(((uint8_t *)data) + i), EE_PARAM_BUFFER_SIZE, EE_WRITE_STATUS);
+    EEPROM_FlushPage();
+    EEPROM_CountRotations(counter + i * EE_COUNTER_SEGMENT_SIZE, rotated);
+  }
+#else // EEPROM_BACKEND == 1 && EEPROM_WEAR_LEVEL_FACTOR > 1
+  for (uint16_t i = 0; i < len; ++i) {
+    uint8_t rotated = EEPROM_WriteByte(param + i * ((uint16_t)EE_PARAM_BUFFER_SIZE * 2), *(((uint8_t *)data) + i), EE_PARAM_BUFFER_SIZE, EE_WRITE_DATA | EE_WRITE_STATUS);
+    EEPROM_FlushPage();
+    EEPROM_CountRotations(counter + i * EE_COUNTER_SEGMENT_SIZE, rotated);
+  }
+#endif // EEPROM_BACKEND == 1 && EEPROM_WEAR_LEVEL_FACTOR > 1
+}
+
+void EEPROM_EstimateBlockWear(const uint16_t param, const uint16_t len, const uint16_t counter, EEPROM_Wear *wear) {
+  wear->writes = 0;
+  wear->remaining = 0;
+  for (uint16_t i = 0; i < len; ++i) {
+    uint16_t status = param + i * ((uint16_t)EE_PARAM_BUFFER_SIZE * 2) + EE_PARAM_BUFFER_SIZE;
+    EEPROM_Wear byte;
+    EEPROM_EstimateWear(counter + i * EE_COUNTER_SEGMENT_SIZE, EEPROM_FindCurrentLevel(status, EE_PARAM_BUFFER_SIZE), &byte);
+    if (i == 0 || byte.writes > wear->writes)
+      *wear = byte;
+  }
+}
+#endif // EEPROM_ROTATE_WHOLE_BLOCKS
+#endif // EEPROM_INCLUDE_WEAR_FUNCS
+
+#if (EEPROM_INCLUDE_PARAMETER_FUNCS || EEPROM_WRITE_BACK_SIZE)
+// Returns the number of levels of a parameter described in a table
+static inline EEPROM_Level EEPROM_ParameterLevels(const EEPROM_Parameter *p) {
+#if (EEPROM_PER_PARAMETER_LEVELS)
+  if (p->levels)
+    return p->levels;
+#else // EEPROM_PER_PARAMETER_LEVELS
+  (void)p;
+#endif // EEPROM_PER_PARAMETER_LEVELS
+  return EE_PARAM_BUFFER_SIZE;
+}
+#endif // EEPROM_INCLUDE_PARAMETER_FUNCS || EEPROM_WRITE_BACK_SIZE
+
+#if (EEPROM_INCLUDE_PARAMETER_FUNCS)
+// Adds a byte to a CRC-16-CCITT
+static uint16_t EEPROM_SignatureUpdate(uint16_t signature, const uint8_t data) {
+  signature ^= (uint16_t)data << 8;
+  for (uint8_t i = 0; i < 8; ++i)
+    signature = (signature & 0x8000) ? (signature << 1) ^ 0x1021 : signature << 1;
+  return signature;
 }
 
+/*
+Returns a signature of the layout of a table of segments, and of the
+configuration that determines the format of each segment. The
+signature is never 0xFFFF, so erased EEPROM never matches it. */
+static uint16_t EEPROM_LayoutSignature(const EEPROM_Parameter *params, const uint8_t count) {
+  uint16_t signature = 0;
+  signature = EEPROM_SignatureUpdate(signature, (uint8_t)EEPROM_WEAR_LEVEL_FACTOR);
+#if (EEPROM_WIDE_LEVELS)
+  signature = EEPROM_SignatureUpdate(signature, EEPROM_WEAR_LEVEL_FACTOR >> 8);
+#endif // EEPROM_WIDE_LEVELS
+  signature = EEPROM_SignatureUpdate(signature, EEPROM_ROTATE_WHOLE_BLOCKS);
+  signature = EEPROM_SignatureUpdate(signature, EEPROM_BIT_CLEARING_STATUS);
+  signature = EEPROM_SignatureUpdate(signature, EEPROM_BACKEND);
+  signature = EEPROM_SignatureUpdate(signature, count);
+  for (uint8_t i = 0; i < count; ++i) {
+    signature = EEPROM_SignatureUpdate(signature, params[i].param);
+    signature = EEPROM_SignatureUpdate(signature, params[i].param >> 8);
+    signature = EEPROM_SignatureUpdate(signature, params[i].len);
+    signature = EEPROM_SignatureUpdate(signature, params[i].len >> 8);
+    signature = EEPROM_SignatureUpdate(signature, EEPROM_ParameterLevels(&params[i]));
+#if (EEPROM_WIDE_LEVELS)
+    signature = EEPROM_SignatureUpdate(signature, EEPROM_ParameterLevels(&params[i]) >> 8);
+#endif // EEPROM_WIDE_LEVELS
+  }
+  return signature == 0xFFFF ? 0 : signature;
+}
+
+#if (EEPROM_BACKEND == 2)
+void EEPROM_ReadWearLeveledParameters(const EEPROM_Parameter *params, const uint8_t count) {
+  for (uint8_t i = 0; i < count; ++i)
+    EEPROM_ReadBlock(params[i].data, params[i].param, params[i].len);
+}
+
+uint8_t EEPROM_InitWearLeveledParametersIfNeeded(const EEPROM_Parameter *params, const uint8_t count, const uint16_t signature) {
+  // Without any metadata, only the signature tells whether the
+  // parameters have been initialized
+  uint16_t expected = EEPROM_LayoutSignature(params, count);
+  if (EEPROM_Read(signature) == (uint8_t)expected && EEPROM_Read(signature + 1) == (uint8_t)(expected >> 8)) {
+    EEPROM_ReadWearLeveledParameters(params, count);
+    return 0;
+  }
+
+  for (uint8_t i = 0; i < count; ++i)
+    if (params[i].len)
+      EEPROM_BackendWritePage(params[i].param, params[i].data, params[i].len);
+  EEPROM_Write(signature, expected);
+  EEPROM_Write(signature + 1, expected >> 8);
+  return count;
+}
+#else // EEPROM_BACKEND
+/*
+Returns the index of the last written element of a status buffer,
+reading each element once, and sets valid to whether the status
+buffer holds values that this library could have written. The
+elements after the last written element must continue the previous
+rotation, except for the element right after it, which a reset may
+have interrupted the write of. The first element is not compared with
+the last one, since the first element may have been interrupted while
+wrapping around, and later writes continue from whatever value it was
+left holding. An erased status buffer of more than 3 levels is never
+valid either, since a status buffer never holds the same value in
+more than one element of a rotation. */
+static EEPROM_Level EEPROM_CheckStatusBuffer(const uint16_t status, const EEPROM_Level levels, uint8_t *valid) {
+  uint8_t previous = EEPROM_Read(status);
+#if (!EEPROM_BIT_CLEARING_STATUS)
+  uint8_t erased = (previous == 0xFF);
+#endif // EEPROM_BIT_CLEARING_STATUS
+  EEPROM_Level level = 0;
+  *valid = 1;
+  for (uint16_t i = 1; i < levels; ++i) {
+    uint8_t element = EEPROM_Read(status + i);
+    if (element == EE_STATUS_AT(previous, 1)) {
+      if (level == i - 1)
+        level = (EEPROM_Level)i;
+    } else if (i > (uint16_t)level + 2) {
+      *valid = 0;
+    }
+#if (!EEPROM_BIT_CLEARING_STATUS)
+    erased &= (element == 0xFF);
+#endif // EEPROM_BIT_CLEARING_STATUS
+    previous = element;
+  }
+#if (!EEPROM_BIT_CLEARING_STATUS)
+  if (levels > 3 && erased)
+    *valid = 0;
+#endif // EEPROM_BIT_CLEARING_STATUS
+  return level;
+}
+
+// What EEPROM_ReadSegment does with a segment
+#define EE_SEGMENT_READ  0 // read it
+#define EE_SEGMENT_CHECK  1 // read it, unless its status buffer is not valid
+#define EE_SEGMENT_INIT  2 // initialize it
+
+/*
+Locates the current level of a segment of len bytes while checking its
+status buffer, and then reads the current value of the segment all at
+once. Depending on the mode, the segment may be initialized with the
+value in memory instead.
+
+Returns:
+  Non-zero if the segment was initialized. */
+static uint8_t EEPROM_ReadSegment(const uint16_t param, uint8_t *data, const uint16_t len, const EEPROM_Level levels, const uint8_t mode) {
+  uint16_t status = param + levels * len;
+  uint8_t valid;
+  EEPROM_Level level = EEPROM_CheckStatusBuffer(status, levels, &valid);
+  if (mode == EE_SEGMENT_INIT || (mode == EE_SEGMENT_CHECK && !valid)) {
+    EEPROM_InitStatusBuffer(status, levels);
+    for (uint16_t i = 0; i < len; ++i)
+      EEPROM_Write(param + i, data[i]);
+    return 1;
+  }
+
+#if (EEPROM_CACHE_SIZE)
+  EEPROM_CacheStore(status, level);
+#endif // EEPROM_CACHE_SIZE
+
+  EEPROM_ReadBlock(data, param + level * len, len);
+  return 0;
+}
+
+/*
+Reads, or initializes, every segment of each parameter in a table.
+
+Returns:
+  The number of parameters that had any segment initialized. */
+static uint8_t EEPROM_ReadParameters(const EEPROM_Parameter *params, const uint8_t count, const uint8_t mode) {
+  uint8_t initialized = 0;
+  for (uint8_t i = 0; i < count; ++i) {
+    EEPROM_Level levels = EEPROM_ParameterLevels(&params[i]);
+#if (EEPROM_ROTATE_WHOLE_BLOCKS)
+    uint8_t any = EEPROM_ReadSegment(params[i].param, params[i].data, params[i].len, levels, mode);
+#else // EEPROM_ROTATE_WHOLE_BLOCKS
+    // Each byte of a block is a segment of its own
+    uint8_t any = 0;
+    for (uint16_t j = 0; j < params[i].len; ++j)
+      any |= EEPROM_ReadSegment(params[i].param + j * ((uint16_t)levels * 2),
+                                ((uint8_t *)params[i].data) + j, 1, levels, mode);
+#endif // EEPROM_ROTATE_WHOLE_BLOCKS
+    initialized += any;
+  }
+  EEPROM_FlushPage();
+  return initialized;
+}
+
+void EEPROM_ReadWearLeveledParameters(const EEPROM_Parameter *params, const uint8_t count) {
+  EEPROM_ReadParameters(params, count, EE_SEGMENT_READ);
+}
+
+uint8_t EEPROM_InitWearLeveledParametersIfNeeded(const EEPROM_Parameter *params, const uint8_t count, const uint16_t signature) {
+  // Every segment is initialized if the layout has changed, and the
+  // signature is only updated after all of them have been
+  uint16_t expected = EEPROM_LayoutSignature(params, count);
+  uint8_t initialize = EEPROM_Read(signature) != (uint8_t)expected || EEPROM_Read(signature + 1) != (uint8_t)(expected >> 8);
+  uint8_t initialized = EEPROM_ReadParameters(params, count, initialize ? EE_SEGMENT_INIT : EE_SEGMENT_CHECK);
+  if (initialize) {
+    EEPROM_Write(signature, expected);
+    EEPROM_Write(signature + 1, expected >> 8);
+    EEPROM_FlushPage();
+  }
+  return initialized;
+}
+#endif // EEPROM_BACKEND
+#endif // EEPROM_INCLUDE_PARAMETER_FUNCS
+
+#if (EEPROM_WRITE_BACK_SIZE)
+#if (EEPROM_WRITE_BACK_SIZE > 255)
+#error "EEPROM_WRITE_BACK_SIZE must not be larger than 255"
+#endif // EEPROM_WRITE_BACK_SIZE
+#if (EEPROM_INCLUDE_BLOCK_FUNCS == 0)
+#error "EEPROM_WRITE_BACK_SIZE requires EEPROM_INCLUDE_BLOCK_FUNCS = 1"
 #endif // EEPROM_INCLUDE_BLOCK_FUNCS
+void EEPROM_InitWriteBack(const EEPROM_Parameter *params, const uint8_t count) {
+  EE_STATE.writeBackParams = params;
+  // Parameters past the ones the dirty bits have room for are left out
+  EE_STATE.writeBackCount = count < (uint8_t)EEPROM_WRITE_BACK_SIZE ? count : (uint8_t)EEPROM_WRITE_BACK_SIZE;
+  for (uint8_t i = 0; i < sizeof(EE_STATE.dirty); ++i)
+    EE_STATE.dirty[i] = 0;
+}
+
+void EEPROM_MarkDirty(const uint8_t index) {
+  if (index >= EE_STATE.writeBackCount)
+    return;
+  EE_STATE.dirty[index / 8] |= (uint8_t)1 << (index % 8);
+}
+
+// Returns the index of the first changed parameter, or the number of parameters if there are none
+static uint8_t EEPROM_FindDirty(uint8_t index) {
+  for (; index < EE_STATE.writeBackCount; ++index)
+    if (EE_STATE.dirty[index / 8] & ((uint8_t)1 << (index % 8)))
+      break;
+  return index;
+}
+
+static void EEPROM_WriteBack(const uint8_t index) {
+  EE_STATE.dirty[index / 8] &= ~((uint8_t)1 << (index % 8));
+  EEPROM_WriteWearLeveledBlockN(EE_STATE.writeBackParams[index].param,
+                                EE_STATE.writeBackParams[index].data,
+                                EE_STATE.writeBackParams[index].len,
+                                EEPROM_ParameterLevels(&EE_STATE.writeBackParams[index]));
+}
+
+void EEPROM_Flush(void) {
+  for (uint8_t i = EEPROM_FindDirty(0); i < EE_STATE.writeBackCount; i = EEPROM_FindDirty(i + 1))
+    EEPROM_WriteBack(i);
+}
+
+uint8_t EEPROM_FlushIfIdle(void) {
+  uint8_t i = EEPROM_FindDirty(0);
+  if (i == EE_STATE.writeBackCount)
+    return 0;
+
+#if (defined(F_CPU) && EEPROM_BACKEND == 0)
+  if (!eeprom_is_ready())
+    return 1;
+#endif // F_CPU && EEPROM_BACKEND == 0
+#if (EEPROM_WRITE_QUEUE_SIZE)
+  if (EE_STATE.queueCount)
+    return 1;
+#endif // EEPROM_WRITE_QUEUE_SIZE
+
+  EEPROM_WriteBack(i);
+  return EEPROM_FindDirty(i + 1) != EE_STATE.writeBackCount;
+}
+#endif // EEPROM_WRITE_BACK_SIZE
+
+#if (EEPROM_LOG_SIZE)
+#if (EEPROM_LOG_KEYS < 1 || EEPROM_LOG_KEYS > 255)
+#error "EEPROM_LOG_KEYS must be between 1 and 255"
+#endif // EEPROM_LOG_KEYS
+#if (EEPROM_LOG_SIZE < 8)
+#error "EEPROM_LOG_SIZE must be at least 8"
+#endif // EEPROM_LOG_SIZE
+#ifdef F_CPU
+#if (EEPROM_BACKEND)
+#if (EEPROM_LOG_BEGIN + EEPROM_LOG_SIZE > EEPROM_EXTERNAL_SIZE)
+#error "The log does not fit into EEPROM_EXTERNAL_SIZE"
+#endif // EEPROM_LOG_BEGIN + EEPROM_LOG_SIZE
+#elif (EEPROM_LOG_BEGIN + EEPROM_LOG_SIZE > E2END + 1)
+#error "The log does not fit into the EEPROM"
+#endif // EEPROM_BACKEND
+#else // F_CPU
+#if (EEPROM_LOG_BEGIN + EEPROM_LOG_SIZE > EEPROM_SIMULATED_SIZE)
+#error "The log does not fit into EEPROM_SIMULATED_SIZE"
+#endif // EEPROM_LOG_BEGIN + EEPROM_LOG_SIZE
+#endif // F_CPU
+/*
+The log is split into two areas of equal size, only one of which holds
+the current records at any time. Each area begins with a sequence
+number (0, 1 or 2, where an erased byte means the area is unused),
+followed by records that are appended one after the other:
+
+  [sequence][key][len][value: len bytes][commit]...[erased bytes]
+
+A record is only committed once its commit byte has been cleared,
+after every other byte of the record has been written, and every byte
+after the last committed record is kept erased. To compact the log,
+the latest record of every key is copied into the other area, which is
+only given the next sequence number once the copy is complete, so an
+interrupted compaction leaves the previous area current.
+
+A compaction is made in steps, so that no single call has to wait for
+all of it: each step erases up to EE_LOG_ERASE_STEP bytes of the other
+area, copies the latest record of one key, or commits the other area.
+A value written to a key whose record has already been copied is
+appended to both areas. */
+#define EE_LOG_AREA_SIZE ((uint16_t)(EEPROM_LOG_SIZE / 2))
+#define EE_LOG_SEQUENCES 3
+#define EE_LOG_EMPTY 0xFF
+#define EE_LOG_COMMITTED 0x00
+// The size of a record holding len bytes
+#define EE_LOG_RECORD_SIZE(len) ((uint16_t)(len) + 3)
+
+// The steps of a compaction
+#define EE_LOG_IDLE  0 // no compaction is in progress
+#define EE_LOG_ERASING  1 // the other area is being erased
+#define EE_LOG_COPYING  2 // the latest records are being copied into the other area
+
+// The number of bytes erased by each step of a compaction, which is a
+// whole page of an external EEPROM
+#if (EEPROM_BACKEND == 1)
+#define EE_LOG_ERASE_STEP ((uint16_t)EEPROM_PAGE_SIZE)
+#else // EEPROM_BACKEND
+#define EE_LOG_ERASE_STEP ((uint16_t)8)
+#endif // EEPROM_BACKEND
+
+static uint16_t EEPROM_LogAreaEnd(void) {
+  return EE_STATE.logArea + EE_LOG_AREA_SIZE;
+}
+
+static uint16_t EEPROM_LogOtherArea(void) {
+  return EE_STATE.logArea == EEPROM_LOG_BEGIN ? EEPROM_LOG_BEGIN + EE_LOG_AREA_SIZE : EEPROM_LOG_BEGIN;
+}
+
+// Returns the number of bytes taken by the latest record of every key
+// other than the given one
+static uint16_t EEPROM_LogLiveSize(const uint8_t except) {
+  uint16_t size = 0;
+  for (uint8_t i = 0; i < EEPROM_LOG_KEYS; ++i)
+    if (i != except && EE_STATE.logIndex[i])
+      size += EE_LOG_RECORD_SIZE(EEPROM_Read(EE_STATE.logIndex[i] + 1));
+  return size;
+}
+
+// Erases every byte between two addresses that is not already erased
+static void EEPROM_LogErase(uint16_t address, const uint16_t end) {
+  for (; address != end; ++address)
+    if (EEPROM_Read(address) != 0xFF)
+      EEPROM_Write(address, 0xFF);
+}
+
+// Rebuilds the index from the records in the current area
+static void EEPROM_LogScan(void) {
+  for (uint8_t i = 0; i < EEPROM_LOG_KEYS; ++i)
+    EE_STATE.logIndex[i] = 0;
+
+  uint16_t end = EEPROM_LogAreaEnd();
+  uint16_t address = EE_STATE.logArea + 1;
+  while (end - address >= EE_LOG_RECORD_SIZE(0)) {
+    uint8_t key = EEPROM_Read(address);
+    if (key == EE_LOG_EMPTY)
+      break;
+    uint8_t len = EEPROM_Read(address + 1);
+    if (end - address < EE_LOG_RECORD_SIZE(len) || EEPROM_Read(address + 2 + len) != EE_LOG_COMMITTED)
+      break;
+    // Records of keys that are out of range are left out of the index,
+    // and are dropped by the next compaction
+    if (key < EEPROM_LOG_KEYS)
+      EE_STATE.logIndex[key] = address;
+    address += EE_LOG_RECORD_SIZE(len);
+  }
+  EE_STATE.logEnd = address;
+
+  // Erase whatever an interrupted append left after the last record
+  EEPROM_LogErase(address, end);
+  EEPROM_FlushPage();
+}
+
+// Writes a record, and commits it once the rest of it has been written
+static void EEPROM_LogAppend(const uint16_t address, const uint8_t key, const void *data, const uint8_t len) {
+  EEPROM_Write(address, key);
+  EEPROM_Write(address + 1, len);
+  for (uint8_t i = 0; i < len; ++i)
+    EEPROM_Write(address + 2 + i, *(((uint8_t *)data) + i));
+  EEPROM_FlushPage();
+  EEPROM_Write(address + 2 + len, EE_LOG_COMMITTED);
+}
+
+// Copies a record, commit byte last, and returns its size
+static uint16_t EEPROM_LogCopy(const uint16_t address, const uint16_t record) {
+  uint16_t size = EE_LOG_RECORD_SIZE(EEPROM_Read(record + 1));
+  for (uint16_t i = 0; i < size; ++i)
+    EEPROM_Write(address + i, EEPROM_Read(record + i));
+  EEPROM_FlushPage();
+  return size;
+}
+
+// Makes the other area current by giving it the next sequence number
+static void EEPROM_LogCommit(const uint16_t area) {
+  EEPROM_Write(area, (EEPROM_Read(EE_STATE.logArea) + 1) % EE_LOG_SEQUENCES);
+  EEPROM_FlushPage();
+  EE_STATE.logArea = area;
+  EE_STATE.logCompacting = EE_LOG_IDLE;
+}
+
+/*
+Copies the latest record of every key into the other area all at once,
+except that the record of the given key is replaced by a record holding
+a new value, which is only needed when the log has no room left for
+the new value even after a compaction. */
+static void EEPROM_LogCompact(const uint8_t key, const void *data, const uint8_t len) {
+  uint16_t area = EEPROM_LogOtherArea();
+
+  // Erasing the other area starts with its sequence number, so that it
+  // is unused until every record has been copied into it
+  EEPROM_LogErase(area, area + EE_LOG_AREA_SIZE);
+
+  uint16_t address = area + 1;
+  for (uint8_t i = 0; i < EEPROM_LOG_KEYS; ++i) {
+    uint16_t record = EE_STATE.logIndex[i];
+    if (i == key) {
+      EEPROM_LogAppend(address, key, data, len);
+      EEPROM_FlushPage();
+      EE_STATE.logIndex[i] = address;
+      address += EE_LOG_RECORD_SIZE(len);
+    } else if (record) {
+      EE_STATE.logIndex[i] = address;
+      address += EEPROM_LogCopy(address, record);
+    }
+  }
+
+  EEPROM_LogCommit(area);
+  EE_STATE.logEnd = address;
+}
+
+// Takes one step of a compaction, starting one if none is in progress,
+// and returns the number of bytes of the other area it went over
+static uint16_t EEPROM_LogStep(void) {
+  uint16_t area = EEPROM_LogOtherArea();
+  uint16_t end = area + EE_LOG_AREA_SIZE;
+  if (EE_STATE.logCompacting == EE_LOG_IDLE) {
+    EE_STATE.logCompacting = EE_LOG_ERASING;
+    EE_STATE.logCopyAddress = area;
+  }
+
+  if (EE_STATE.logCompacting == EE_LOG_ERASING) {
+    // Erasing the other area starts with its sequence number, so that it
+    // is unused until every record has been copied into it
+    uint16_t address = EE_STATE.logCopyAddress;
+    uint16_t next = (address + EE_LOG_ERASE_STEP) & ~(EE_LOG_ERASE_STEP - 1);
+    if (next > end)
+      next = end;
+    EEPROM_LogErase(address, next);
+    EEPROM_FlushPage();
+    EE_STATE.logCopyAddress = next;
+    if (next == end) {
+      EE_STATE.logCompacting = EE_LOG_COPYING;
+      EE_STATE.logCopyKey = 0;
+      EE_STATE.logCopyAddress = area + 1;
+    }
+    return next - address;
+  }
+
+  while (EE_STATE.logCopyKey != EEPROM_LOG_KEYS && !EE_STATE.logIndex[EE_STATE.logCopyKey])
+    ++EE_STATE.logCopyKey;
+  if (EE_STATE.logCopyKey != EEPROM_LOG_KEYS) {
+    uint16_t record = EE_STATE.logIndex[EE_STATE.logCopyKey++];
+    if (end - EE_STATE.logCopyAddress < EE_LOG_RECORD_SIZE(EEPROM_Read(record + 1))) {
+      // Values appended to both areas have filled the other area, so
+      // the compaction starts over
+      EE_STATE.logCompacting = EE_LOG_ERASING;
+      EE_STATE.logCopyAddress = area;
+      return 0;
+    }
+    uint16_t size = EEPROM_LogCopy(EE_STATE.logCopyAddress, record);
+    EE_STATE.logCopyAddress += size;
+    return size;
+  }
+
+  EEPROM_LogCommit(area);
+  EEPROM_LogScan();
+  return 0;
+}
+
+uint8_t EEPROM_CompactLogStep(void) {
+  EEPROM_LogStep();
+  return EE_STATE.logCompacting != EE_LOG_IDLE;
+}
+
+void EEPROM_InitLog(void) {
+  EEPROM_LogErase(EEPROM_LOG_BEGIN, EEPROM_LOG_BEGIN + 2 * EE_LOG_AREA_SIZE);
+  EEPROM_Write(EEPROM_LOG_BEGIN, 0);
+  EEPROM_FlushPage();
+
+  EE_STATE.logArea = EEPROM_LOG_BEGIN;
+  EE_STATE.logEnd = EEPROM_LOG_BEGIN + 1;
+  EE_STATE.logCompacting = EE_LOG_IDLE;
+  for (uint8_t i = 0; i < EEPROM_LOG_KEYS; ++i)
+    EE_STATE.logIndex[i] = 0;
+}
+
+uint8_t EEPROM_LoadLog(void) {
+  uint8_t first = EEPROM_Read(EEPROM_LOG_BEGIN);
+  uint8_t second = EEPROM_Read(EEPROM_LOG_BEGIN + EE_LOG_AREA_SIZE);
+  if (first >= EE_LOG_SEQUENCES && second >= EE_LOG_SEQUENCES)
+    return 0;
+
+  // The second area is current if the first one is unused, or if the
+  // first one was compacted into the second one
+  if (first >= EE_LOG_SEQUENCES || (second < EE_LOG_SEQUENCES && second == (first + 1) % EE_LOG_SEQUENCES))
+    EE_STATE.logArea = EEPROM_LOG_BEGIN + EE_LOG_AREA_SIZE;
+  else
+    EE_STATE.logArea = EEPROM_LOG_BEGIN;
+  EE_STATE.logCompacting = EE_LOG_IDLE;
+  EEPROM_LogScan();
+  return 1;
+}
+
+uint8_t EEPROM_ReadLogValue(const uint8_t key, void *data, const uint8_t len) {
+  if (key >= EEPROM_LOG_KEYS)
+    return 0;
+  uint16_t record = EE_STATE.logIndex[key];
+  if (!record)
+    return 0;
+
+  uint8_t stored = EEPROM_Read(record + 1);
+  EEPROM_ReadBlock(data, record + 2, stored < len ? stored : len);
+  return 1;
+}
+
+/*
+Takes steps of a compaction after a record of the given size has been
+appended. A compaction goes over the whole other area and then the
+latest records, and each write takes steps going over four times as many
+bytes as it appended, with the bytes a step went over beyond that taken
+off the next write, so a compaction is started once the free space of
+the current area drops below a third of the bytes it has to go over.
+That leaves room for the compaction to finish before the current area is
+full, unless larger values are written meanwhile. */
+static void EEPROM_LogPace(const uint16_t size) {
+  if (EE_STATE.logCompacting == EE_LOG_IDLE) {
+    // No compaction is started with two thirds of the area free, which
+    // saves going over the index after most writes
+    uint16_t free = EEPROM_LogFree();
+    if (free >= EE_LOG_AREA_SIZE - EE_LOG_AREA_SIZE / 3)
+      return;
+    uint16_t live = EEPROM_LogLiveSize(EEPROM_LOG_KEYS);
+    if (free >= (EE_LOG_AREA_SIZE + live) / 3 || EE_LOG_AREA_SIZE - 1 - live <= free)
+      return;
+    EE_STATE.logBudget = 0;
+  }
+
+  EE_STATE.logBudget += 4 * size;
+  while (EE_STATE.logBudget > 0) {
+    EE_STATE.logBudget -= EEPROM_LogStep();
+    if (EE_STATE.logCompacting == EE_LOG_IDLE)
+      break;
+  }
+}
+
+static uint8_t EEPROM_LogWrite(const uint8_t key, const void *data, const uint8_t len) {
+  if (key >= EEPROM_LOG_KEYS)
+    return 0;
+
+  // Only append a record if the new value is different from what's currently stored
+  uint16_t record = EE_STATE.logIndex[key];
+  if (record && EEPROM_Read(record + 1) == len) {
+    uint8_t i;
+    for (i = 0; i < len; ++i)
+      if (EEPROM_Read(record + 2 + i) != *(((uint8_t *)data) + i))
+        break;
+    if (i == len)
+      return 1;
+  }
+
+  uint16_t size = EE_LOG_RECORD_SIZE(len);
+  if (EEPROM_LogFree() < size && EE_STATE.logCompacting != EE_LOG_IDLE) {
+    // The compaction in progress has to be finished to make room
+    while (EEPROM_CompactLogStep())
+      ;
+  }
+
+  if (EEPROM_LogFree() < size) {
+    // The new value replaces the latest record of the key while the
+    // log is compacted, so the record only has to fit alongside the
+    // latest records of the other keys
+    if (size + EEPROM_LogLiveSize(key) > EE_LOG_AREA_SIZE - 1)
+      return 0;
+    EEPROM_LogCompact(key, data, len);
+    return 1;
+  }
+
+  EEPROM_LogAppend(EE_STATE.logEnd, key, data, len);
+  EEPROM_FlushPage();
+  EE_STATE.logIndex[key] = EE_STATE.logEnd;
+  EE_STATE.logEnd += size;
+
+  if (EE_STATE.logCompacting == EE_LOG_COPYING && key < EE_STATE.logCopyKey) {
+    // The latest record of the key has already been copied into the
+    // other area, so the new record is appended there too, unless the
+    // other area has no room left for it, in which case the compaction
+    // starts over
+    if (EEPROM_LogOtherArea() + EE_LOG_AREA_SIZE - EE_STATE.logCopyAddress >= size) {
+      EEPROM_LogAppend(EE_STATE.logCopyAddress, key, data, len);
+      EEPROM_FlushPage();
+      EE_STATE.logCopyAddress += size;
+    } else {
+      EE_STATE.logCompacting = EE_LOG_ERASING;
+      EE_STATE.logCopyAddress = EEPROM_LogOtherArea();
+    }
+  }
+
+  EEPROM_LogPace(size);
+  return 1;
+}
+
+uint8_t EEPROM_WriteLogValue(const uint8_t key, const void *data, const uint8_t len) {
+  EE_PROFILE_BEGIN();
+  uint8_t written = EEPROM_LogWrite(key, data, len);
+  EE_PROFILE_END(EE_PROFILE_WRITE_LOG_VALUE, 1);
+  return written;
+}
+
+void EEPROM_CompactLog(void) {
+  while (EEPROM_CompactLogStep())
+    ;
+}
+
+uint16_t EEPROM_LogFree(void) {
+  return EEPROM_LogAreaEnd() - EE_STATE.logEnd;
+}
+#endif // EEPROM_LOG_SIZE
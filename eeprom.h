@@ -50,6 +50,157 @@
  * time you flash a new program), and enable BOD (Brown Out Detection)
  * to avoid EEPROM corruption if the supply voltage falls too low.
  */
+
+/*
+ * EEPROM_Level
+ *
+ * The type of the number of levels of a segment, and of the index of
+ * one of its levels. A segment has between 1 and EE_MAX_LEVELS levels,
+ * which is 255, or 65535 when EEPROM_WIDE_LEVELS = 1. EE_VALID_LEVELS
+ * tells whether a segment may have a given number of levels.
+ */
+#if (EEPROM_WIDE_LEVELS)
+typedef uint16_t EEPROM_Level;
+#define EE_MAX_LEVELS 65535
+#else // EEPROM_WIDE_LEVELS
+typedef uint8_t EEPROM_Level;
+#define EE_MAX_LEVELS 255
+#endif // EEPROM_WIDE_LEVELS
+#define EE_VALID_LEVELS(levels) \
+  ((levels) >= 1 && (levels) <= EE_MAX_LEVELS && (EEPROM_BIT_CLEARING_STATUS || (levels) % 256))
+
+/*
+ * EE_BYTE_SEGMENT_SIZE
+ *
+ * The number of bytes of EEPROM, including metadata, occupied by a
+ * segment initialized with EEPROM_InitWearLeveledByte. The size of a
+ * segment with a given number of levels, initialized with
+ * EEPROM_InitWearLeveledByteN, is EE_BYTE_SEGMENT_SIZE_N(levels).
+ * When EEPROM_BACKEND = 2, there is no metadata, and a segment is a
+ * single byte.
+ */
+#if (EEPROM_BACKEND == 2)
+#define EE_BYTE_SEGMENT_SIZE_N(levels) 1
+#else // EEPROM_BACKEND
+#define EE_BYTE_SEGMENT_SIZE_N(levels) ((levels) * 2)
+#endif // EEPROM_BACKEND
+#define EE_BYTE_SEGMENT_SIZE EE_BYTE_SEGMENT_SIZE_N(EEPROM_WEAR_LEVEL_FACTOR)
+
+/*
+ * EE_BLOCK_SEGMENT_SIZE
+ *
+ * The number of bytes of EEPROM, including metadata, occupied by a
+ * segment of len bytes initialized with EEPROM_InitWearLeveledBlock.
+ * The size of a segment with a given number of levels, initialized
+ * with EEPROM_InitWearLeveledBlockN, is
+ * EE_BLOCK_SEGMENT_SIZE_N(len, levels). When EEPROM_BACKEND = 2, there
+ * is no metadata, and a segment is len bytes.
+ */
+#if (EEPROM_BACKEND == 2)
+#define EE_BLOCK_SEGMENT_SIZE_N(len, levels) (len)
+#elif (EEPROM_ROTATE_WHOLE_BLOCKS)
+#define EE_BLOCK_SEGMENT_SIZE_N(len, levels) (((len) + 1) * (levels))
+#else // EEPROM_ROTATE_WHOLE_BLOCKS
+#define EE_BLOCK_SEGMENT_SIZE_N(len, levels) ((len) * (levels) * 2)
+#endif // EEPROM_BACKEND == 2, EEPROM_ROTATE_WHOLE_BLOCKS
+#define EE_BLOCK_SEGMENT_SIZE(len) EE_BLOCK_SEGMENT_SIZE_N(len, EEPROM_WEAR_LEVEL_FACTOR)
+
+/*
+ * EE_VERSIONED_BLOCK_SEGMENT_SIZE
+ *
+ * The number of bytes of EEPROM, including metadata, occupied by a
+ * segment of len bytes initialized with EEPROM_InitVersionedBlock.
+ */
+#define EE_VERSIONED_BLOCK_SEGMENT_SIZE(len) (((len) + 1) * EEPROM_WEAR_LEVEL_FACTOR)
+
+/*
+ * EE_COUNTER_SEGMENT_SIZE
+ *
+ * The number of bytes of EEPROM, including metadata, occupied by a
+ * counter initialized with EEPROM_InitWearLeveledCounter.
+ */
+#if (EEPROM_BACKEND == 2)
+#define EE_COUNTER_ROLLOVERS_SIZE (2 * sizeof(uint32_t) + 1)
+#else // EEPROM_BACKEND
+// At least two copies of the number of rollovers are needed for either
+// to be left intact by an interrupted rollover
+#define EE_COUNTER_LEVELS (EEPROM_WEAR_LEVEL_FACTOR > 1 ? EEPROM_WEAR_LEVEL_FACTOR : 2)
+#define EE_COUNTER_ROLLOVERS_SIZE ((sizeof(uint32_t) + 1) * EE_COUNTER_LEVELS)
+#endif // EEPROM_BACKEND
+#define EE_COUNTER_SEGMENT_SIZE (EE_COUNTER_ROLLOVERS_SIZE + 2 * EEPROM_COUNTER_UNARY_SIZE)
+
+/*
+ * EE_BLOCK_COUNTERS_SIZE
+ *
+ * The number of bytes of EEPROM occupied by the counters of rotations
+ * of a block of len bytes written with EEPROM_WriteTrackedBlock, which
+ * are a counter for each byte unless EEPROM_ROTATE_WHOLE_BLOCKS is set.
+ */
+#if (EEPROM_ROTATE_WHOLE_BLOCKS)
+#define EE_BLOCK_COUNTERS_SIZE(len) EE_COUNTER_SEGMENT_SIZE
+#else // EEPROM_ROTATE_WHOLE_BLOCKS
+#define EE_BLOCK_COUNTERS_SIZE(len) ((len) * EE_COUNTER_SEGMENT_SIZE)
+#endif // EEPROM_ROTATE_WHOLE_BLOCKS
+
+/*
+ * If EEPROM_PARAMETERS is defined before including this header file,
+ * then the layout of every wear-leveled parameter in EEPROM will be
+ * computed at compile time, and a set of inline functions for
+ * accessing each parameter will be defined.
+ *
+ * EEPROM_PARAMETERS should be defined to invoke the macro passed to
+ * it once for each parameter, in the order the parameters should be
+ * stored in EEPROM, with the name and type of the parameter, and when
+ * EEPROM_PER_PARAMETER_LEVELS is set, optionally the number of levels
+ * the parameter uses instead of EEPROM_WEAR_LEVEL_FACTOR:
+ *
+ *   #define EEPROM_PARAMETERS(X) \
+ *     X(Volume, uint8_t)         \
+ *     X(Settings, struct settings_t)
+ *
+ * For each parameter, EE_OFFSET(name) is the offset into EEPROM where
+ * its wear-leveled segment begins, EE_SIZE(name) is the number of
+ * bytes of EEPROM the segment occupies, and the following functions
+ * are defined:
+ *
+ *   void EEPROM_Init<name>(const type *data);
+ *   void EEPROM_Read<name>(type *data);
+ *   void EEPROM_Write<name>(const type *data);
+ *   void EEPROM_Update<name>(const type *data, const type *previous);
+ *
+ * which behave like EEPROM_InitWearLeveledBlock,
+ * EEPROM_ReadWearLeveledBlock, EEPROM_WriteWearLeveledBlock, and
+ * EEPROM_UpdateWearLeveledBlock, but
+ * with the offset and length known at compile time. If EE_EEPROM_END
+ * has not been defined, it is defined to point to the first address
+ * after the last parameter.
+ */
+#ifdef EEPROM_PARAMETERS
+#include <stddef.h>
+// The number of levels of a parameter, from its optional third argument
+#define EE_LEVELS(...) EE_LEVELS_(, ##__VA_ARGS__, EEPROM_WEAR_LEVEL_FACTOR)
+#define EE_LEVELS_(empty, levels, ...) (levels)
+#define EE_LAYOUT_CHECK(name, type, ...)                                \
+  _Static_assert(EEPROM_PER_PARAMETER_LEVELS || EE_LEVELS(__VA_ARGS__) == EEPROM_WEAR_LEVEL_FACTOR, \
+                 "The number of levels of " #name " requires EEPROM_PER_PARAMETER_LEVELS = 1."); \
+  _Static_assert(EE_VALID_LEVELS(EE_LEVELS(__VA_ARGS__)),                \
+                 "The number of levels of " #name " must be between 1 and EE_MAX_LEVELS, " \
+                 "and not a multiple of 256 unless EEPROM_BIT_CLEARING_STATUS = 1.");
+EEPROM_PARAMETERS(EE_LAYOUT_CHECK)
+#undef EE_LAYOUT_CHECK
+#define EE_LAYOUT_SEGMENT(name, type, ...) \
+  uint8_t name[EE_BLOCK_SEGMENT_SIZE_N(sizeof(type), EE_LEVELS(__VA_ARGS__))];
+struct EEPROM_Layout {
+  EEPROM_PARAMETERS(EE_LAYOUT_SEGMENT)
+};
+#undef EE_LAYOUT_SEGMENT
+#define EE_OFFSET(name) ((uint16_t)offsetof(struct EEPROM_Layout, name))
+#define EE_SIZE(name) ((uint16_t)sizeof(((struct EEPROM_Layout *)0)->name))
+#ifndef EE_EEPROM_END
+#define EE_EEPROM_END ((uint16_t)sizeof(struct EEPROM_Layout))
+#endif // EE_EEPROM_END
+#endif // EEPROM_PARAMETERS
+
 #ifdef F_CPU
 #include <avr/io.h>
 /*
@@ -61,11 +212,17 @@
  * the last used parameter.
  */
 #ifdef EE_EEPROM_END
+#if (EEPROM_BACKEND)
+_Static_assert((EE_EEPROM_END <= EEPROM_EXTERNAL_SIZE), "Available EEPROM memory exceeded. Consider setting EEPROM_WEAR_LEVEL_FACTOR to a lower value.");
+#else // EEPROM_BACKEND
 _Static_assert((EE_EEPROM_END <= E2END + 1), "Available EEPROM memory exceeded. Consider setting EEPROM_WEAR_LEVEL_FACTOR to a lower value.");
+#endif // EEPROM_BACKEND
 #endif // EE_EEPROM_END
 #else // F_CPU
-// Only used for simulation when compiled on a computer
-extern uint8_t eeprom[EEPROM_SIMULATED_SIZE];
+// Only used for simulation when compiled on a computer, and refers to
+// the simulated EEPROM selected by the calling thread
+uint8_t (*EEPROM_SimulatedMemory(void))[EEPROM_SIMULATED_SIZE];
+#define eeprom (*EEPROM_SimulatedMemory())
 #ifdef EE_EEPROM_END
 _Static_assert((EE_EEPROM_END <= sizeof(eeprom)), "Available EEPROM memory exceeded. Consider setting EEPROM_WEAR_LEVEL_FACTOR to a lower value.");
 #endif // EE_EEPROM_END
@@ -83,8 +240,354 @@ _Static_assert((EE_EEPROM_END <= sizeof(eeprom)), "Available EEPROM memory excee
  *   to be printed.
  */
 void EEPROM_Print(const uint16_t begin, const uint16_t end);
+
+/*
+ * EEPROM_Instance
+ *
+ * A simulated EEPROM, along with all of the state kept by this library
+ * for it (its write queue, cache, write-back parameters, and access
+ * counters), so that many simulated devices can be run at once, for
+ * example one on each thread of a stress test. Each thread operates on
+ * the instance it has selected with EEPROM_SelectInstance, or on the
+ * default instance, which is shared by every thread, if it has not
+ * selected one. On an AVR, there is only the one EEPROM, and none of
+ * this exists.
+ */
+typedef struct EEPROM_Instance EEPROM_Instance;
+
+/*
+ * EEPROM_CreateInstance
+ *
+ * Creates a simulated EEPROM, which is erased (every byte is 0xFF),
+ * and whose other state is the same as at the start of the program.
+ *
+ * Returns:
+ *   The new instance, or NULL if there was not enough memory.
+ */
+EEPROM_Instance *EEPROM_CreateInstance(void);
+
+/*
+ * EEPROM_DestroyInstance
+ *
+ * Frees a simulated EEPROM created with EEPROM_CreateInstance. If the
+ * calling thread has it selected, the default instance is selected.
+ *
+ * instance [in]
+ *   The instance to be freed.
+ */
+void EEPROM_DestroyInstance(EEPROM_Instance *instance);
+
+/*
+ * EEPROM_SelectInstance
+ *
+ * Selects the simulated EEPROM that every other function of this
+ * library (and the "eeprom" array) operates on, for the calling thread.
+ *
+ * instance [in]
+ *   The instance to be selected, or NULL to select the default instance.
+ */
+void EEPROM_SelectInstance(EEPROM_Instance *instance);
+
+#if (EEPROM_SIMULATED_COUNTERS)
+/*
+ * EEPROM_SimulatedStats
+ *
+ * The accesses to the simulated EEPROM since the program started, or
+ * since the last call to EEPROM_ResetSimulatedStats.
+ *
+ * reads
+ *   The number of bytes read from the simulated EEPROM.
+ *
+ * writes
+ *   The number of bytes written to the simulated EEPROM. Just like
+ *   eeprom_update_byte on an AVR, a write that would not change the
+ *   contents of a byte is not performed, and is not counted.
+ *
+ * erases
+ *   The number of bytes erased. This is the same as writes, unless
+ *   EEPROM_SPLIT_PROGRAMMING = 1, in which case bytes that only need
+ *   bits cleared are written without being erased.
+ *
+ * pages
+ *   The number of page writes to an external EEPROM (when
+ *   EEPROM_BACKEND = 1), every byte of which is counted as written
+ *   and erased, whether or not it changed.
+ *
+ * busy
+ *   The number of nanoseconds an AVR would have spent performing
+ *   these reads, writes and erases.
+ */
+typedef struct {
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t erases;
+  uint32_t pages;
+  uint64_t busy;
+} EEPROM_SimulatedStats;
+
+/*
+ * EEPROM_GetSimulatedStats
+ *
+ * Copies the access counters of the simulated EEPROM.
+ *
+ * stats [out]
+ *   The structure the access counters are copied into.
+ */
+void EEPROM_GetSimulatedStats(EEPROM_SimulatedStats *stats);
+
+/*
+ * EEPROM_ResetSimulatedStats
+ *
+ * Sets the access counters, and the wear counters of every byte, of
+ * the simulated EEPROM to zero.
+ */
+void EEPROM_ResetSimulatedStats(void);
+
+/*
+ * EEPROM_SimulatedCellErases
+ *
+ * Returns the number of times a byte of the simulated EEPROM has been
+ * erased, which is what limits the lifetime of an EEPROM.
+ *
+ * address [in]
+ *   The location of the byte in the simulated EEPROM.
+ */
+uint32_t EEPROM_SimulatedCellErases(const uint16_t address);
+
+/*
+ * EEPROM_SimulatedCellWrites
+ *
+ * Returns the number of times a byte of the simulated EEPROM has been
+ * written.
+ *
+ * address [in]
+ *   The location of the byte in the simulated EEPROM.
+ */
+uint32_t EEPROM_SimulatedCellWrites(const uint16_t address);
+
+/*
+ * EEPROM_PrintWear
+ *
+ * Prints a map of how often each byte of the simulated EEPROM, between
+ * two locations, has been erased, followed by the most erases of any
+ * of those bytes compared to the guaranteed endurance of 100,000 erase
+ * cycles, the access counters and the total simulated busy time.
+ *
+ * begin [in]
+ *   The first location of the simulated EEPROM to be printed.
+ *
+ * end [in]
+ *   The location one after the last location of the simulated EEPROM
+ *   to be printed.
+ */
+void EEPROM_PrintWear(const uint16_t begin, const uint16_t end);
+#endif // EEPROM_SIMULATED_COUNTERS
+
+#if (EEPROM_BACKEND != 2)
+/*
+ * EEPROM_StatusAnalysis
+ *
+ * What the status buffer of a segment, in a dump of an EEPROM read
+ * back from a device, says about the parameter stored in it.
+ *
+ * state
+ *   EE_STATUS_VALID if the status buffer holds what this library
+ *   writes into it, EE_STATUS_BLANK if every element is erased (0xFF),
+ *   so the segment was never initialized, or EE_STATUS_CORRUPT if it
+ *   holds anything else, in which case the level is where this library
+ *   would read the current value from when searching linearly. When
+ *   EEPROM_BIT_CLEARING_STATUS = 1, or there is only one level, an
+ *   initialized status buffer is also erased once every 9 rotations
+ *   (or 256 writes), which cannot be told apart from one that was
+ *   never initialized.
+ *
+ * level
+ *   The index of the level of the param buffer holding the current
+ *   value.
+ *
+ * writes
+ *   The number of times the parameter has been written since it was
+ *   initialized, modulo period, as only that is recorded in the status
+ *   buffer.
+ *
+ * period
+ *   256 when EEPROM_BIT_CLEARING_STATUS = 0, and 9 times the number of
+ *   levels when EEPROM_BIT_CLEARING_STATUS = 1.
+ */
+enum { EE_STATUS_VALID, EE_STATUS_BLANK, EE_STATUS_CORRUPT };
+typedef struct {
+  uint8_t state;
+  EEPROM_Level level;
+  uint32_t writes;
+  uint32_t period;
+} EEPROM_StatusAnalysis;
+
+/*
+ * EEPROM_AnalyzeStatusBuffer
+ *
+ * Decodes the status buffer of a segment, from a dump of an EEPROM
+ * rather than from the simulated EEPROM, so that the dumps of many
+ * devices can be analyzed quickly. Each element is checked against
+ * both rotations it may belong to without branching, which the
+ * compiler vectorizes.
+ *
+ * status [in]
+ *   The status buffer, which is the levels bytes following the param
+ *   buffer of a segment of a wear-leveled byte (or of each byte of a
+ *   block), or following every level of a segment of a block when
+ *   EEPROM_ROTATE_WHOLE_BLOCKS = 1.
+ *
+ * levels [in]
+ *   The number of levels of the segment.
+ *
+ * analysis [out]
+ *   The structure the decoded status is stored into.
+ */
+void EEPROM_AnalyzeStatusBuffer(const uint8_t *status, const EEPROM_Level levels, EEPROM_StatusAnalysis *analysis);
+#endif // EEPROM_BACKEND
 #endif // F_CPU
 
+#if (EEPROM_BACKEND)
+/*
+ * When EEPROM_BACKEND = 1, the parameters are stored in an external
+ * EEPROM, such as a 24LC256, and when EEPROM_BACKEND = 2, in an
+ * external FRAM, such as an MB85RC256V, which is accessed through the
+ * following three functions. When compiled for an AVR, they must be
+ * provided by the application (for example, using the TWI or SPI
+ * peripheral). When compiled on a computer, they are provided by this
+ * library, and operate on the simulated EEPROM.
+ */
+
+/*
+ * EEPROM_BackendRead
+ *
+ * Reads a byte from the external EEPROM.
+ *
+ * address [in]
+ *   The location of the byte in the external EEPROM.
+ *
+ * Returns:
+ *   The contents of the byte.
+ */
+uint8_t EEPROM_BackendRead(const uint16_t address);
+
+/*
+ * EEPROM_BackendReadBlock
+ *
+ * Reads consecutive bytes from the external EEPROM, in one sequential
+ * read.
+ *
+ * data [out]
+ *   The location in memory the bytes are read into.
+ *
+ * address [in]
+ *   The location of the first byte in the external EEPROM.
+ *
+ * len [in]
+ *   The number of bytes to read.
+ */
+void EEPROM_BackendReadBlock(void *data, const uint16_t address, const uint16_t len);
+
+/*
+ * EEPROM_BackendWritePage
+ *
+ * Writes consecutive bytes, which are all within the same page of
+ * EEPROM_PAGE_SIZE bytes, to the external EEPROM, in one page write.
+ * It may return before the write cycle finishes, as long as the next
+ * call to any of these functions waits for it to finish (for example,
+ * by acknowledge polling). FRAM has no pages, so when
+ * EEPROM_BACKEND = 2, any number of bytes may be written at once.
+ *
+ * address [in]
+ *   The location of the first byte in the external EEPROM.
+ *
+ * data [in]
+ *   The location in memory of the bytes to write.
+ *
+ * len [in]
+ *   The number of bytes to write, from 1 to EEPROM_PAGE_SIZE (or any
+ *   number greater than 0 for FRAM).
+ */
+void EEPROM_BackendWritePage(const uint16_t address, const void *data, const uint16_t len);
+#endif // EEPROM_BACKEND
+
+#if (EEPROM_WRITE_QUEUE_SIZE)
+/*
+ * EEPROM_PendingWrites
+ *
+ * Returns:
+ *   The number of queued writes that have not yet been started.
+ */
+uint8_t EEPROM_PendingWrites(void);
+
+/*
+ * EEPROM_PollWrites
+ *
+ * Starts the next queued write, if the EEPROM is not busy. This does
+ * not need to be invoked on an AVR while global interrupts are
+ * enabled, since the queue is drained by the EEPROM Ready interrupt.
+ *
+ * Returns:
+ *   The number of queued writes that have not yet been started.
+ */
+uint8_t EEPROM_PollWrites(void);
+
+/*
+ * EEPROM_FlushWrites
+ *
+ * Waits until every queued write has been completed. This should be
+ * invoked before entering a sleep mode that stops the EEPROM Ready
+ * interrupt, or before removing power from the device.
+ */
+void EEPROM_FlushWrites(void);
+#endif // EEPROM_WRITE_QUEUE_SIZE
+
+#if (EEPROM_DEFERRED_WRITES)
+/*
+ * EEPROM_DeferWearLeveledByte
+ *
+ * Adds a write of a wear-leveled byte to the writes performed by the
+ * next call to EEPROM_ApplyDeferredWrites. This function may be
+ * invoked from an interrupt handler, and only disables interrupts for
+ * a few cycles.
+ *
+ * param [in]
+ *   The offset into EEPROM where the wear-leveled segment begins.
+ *
+ * data [in]
+ *   The data to store in EEPROM.
+ *
+ * Returns:
+ *   1 if the write was deferred, or 0 if EEPROM_DEFERRED_WRITES
+ *   writes are already waiting, in which case it is dropped.
+ */
+uint8_t EEPROM_DeferWearLeveledByte(const uint16_t param, const uint8_t data);
+
+/*
+ * EEPROM_ApplyDeferredWrites
+ *
+ * Performs every deferred write, in the order they were deferred,
+ * with EEPROM_WriteWearLeveledByte. This function must be invoked by
+ * the main program, and never from an interrupt handler.
+ */
+void EEPROM_ApplyDeferredWrites(void);
+#endif // EEPROM_DEFERRED_WRITES
+
+#if (EEPROM_CACHE_SIZE)
+/*
+ * EEPROM_InvalidateCache
+ *
+ * Forgets the current location of every wear-leveled segment that
+ * has been remembered in RAM, so that the next access to each segment
+ * scans its status buffer again.
+ *
+ * This function only needs to be invoked if the contents of the
+ * EEPROM have been modified without using the functions provided by
+ * this library.
+ */
+void EEPROM_InvalidateCache(void);
+#endif // EEPROM_CACHE_SIZE
+
 #if (EEPROM_INCLUDE_BYTE_FUNCS)
 /*
  * EEPROM_InitWearLeveledByte
@@ -143,6 +646,24 @@ uint8_t EEPROM_ReadWearLeveledByte(const uint16_t param);
  * has previously been invoked on the same segment of EEPROM.
  */
 void EEPROM_WriteWearLeveledByte(const uint16_t param, const uint8_t data);
+
+#if (EEPROM_PER_PARAMETER_LEVELS)
+/*
+ * EEPROM_InitWearLeveledByteN
+ * EEPROM_ReadWearLeveledByteN
+ * EEPROM_WriteWearLeveledByteN
+ *
+ * These functions behave like the functions above, but the segment
+ * of EEPROM distributes writes across the given number of levels
+ * (see EEPROM_Level), rather than EEPROM_WEAR_LEVEL_FACTOR, and
+ * occupies EE_BYTE_SEGMENT_SIZE_N(levels) bytes of EEPROM. A segment
+ * must always be accessed with the same number of levels it was
+ * initialized with.
+ */
+uint8_t EEPROM_InitWearLeveledByteN(const uint16_t param, const uint8_t data, const EEPROM_Level levels);
+uint8_t EEPROM_ReadWearLeveledByteN(const uint16_t param, const EEPROM_Level levels);
+void EEPROM_WriteWearLeveledByteN(const uint16_t param, const uint8_t data, const EEPROM_Level levels);
+#endif // EEPROM_PER_PARAMETER_LEVELS
 #endif // EEPROM_INCLUDE_BYTE_FUNCS
 
 #if (EEPROM_INCLUDE_BLOCK_FUNCS)
@@ -152,7 +673,10 @@ void EEPROM_WriteWearLeveledByte(const uint16_t param, const uint8_t data);
  * Initializes a segment of EEPROM to use for wear-leveled storage of
  * a block of memory, and writes the contents of the buffer to
  * EEPROM. The total length of this segment, including metadata,
- * occupies (len * EEPROM_WEAR_LEVEL_FACTOR * 2) bytes of EEPROM.
+ * occupies EE_BLOCK_SEGMENT_SIZE(len) bytes of EEPROM, which is
+ * (len * EEPROM_WEAR_LEVEL_FACTOR * 2) bytes, or when
+ * EEPROM_ROTATE_WHOLE_BLOCKS is set, ((len + 1) *
+ * EEPROM_WEAR_LEVEL_FACTOR) bytes.
  * 
  * param [in]
  *   The offset into EEPROM where the wear-leveled segment begins.
@@ -212,4 +736,810 @@ void EEPROM_ReadWearLeveledBlock(const uint16_t param, void *data, const uint16_
  * has previously been invoked on the same segment of EEPROM.
  */
 void EEPROM_WriteWearLeveledBlock(const uint16_t param, const void *data, const uint16_t len);
+
+/*
+ * EEPROM_UpdateWearLeveledBlock
+ *
+ * Writes the contents of the supplied buffer into a wear-leveled
+ * segment of EEPROM, like EEPROM_WriteWearLeveledBlock, but compares
+ * it with a copy in memory of the block currently stored, rather than
+ * with the EEPROM, so that only the bytes that changed are looked up
+ * and written, and writing an unchanged block reads nothing from
+ * EEPROM.
+ *
+ * param [in]
+ *   The offset into EEPROM where the wear-leveled segment begins.
+ *
+ * data [in]
+ *   A pointer to the buffer containing the data to store in EEPROM.
+ *
+ * previous [in]
+ *   A pointer to a buffer containing the block currently stored in
+ *   EEPROM, such as the one last read or written.
+ *
+ * len [in]
+ *   The size of both buffers, in bytes.
+ *
+ * This function may only be invoked if EEPROM_InitWearLeveledBlock
+ * has previously been invoked on the same segment of EEPROM.
+ */
+void EEPROM_UpdateWearLeveledBlock(const uint16_t param, const void *data, const void *previous, const uint16_t len);
+
+#if (EEPROM_PER_PARAMETER_LEVELS)
+/*
+ * EEPROM_InitWearLeveledBlockN
+ * EEPROM_ReadWearLeveledBlockN
+ * EEPROM_WriteWearLeveledBlockN
+ * EEPROM_UpdateWearLeveledBlockN
+ *
+ * These functions behave like the functions above, but the segment
+ * of EEPROM distributes writes across the given number of levels
+ * (see EEPROM_Level), rather than EEPROM_WEAR_LEVEL_FACTOR, and
+ * occupies EE_BLOCK_SEGMENT_SIZE_N(len, levels) bytes of EEPROM. A
+ * segment must always be accessed with the same number of levels it
+ * was initialized with.
+ */
+void EEPROM_InitWearLeveledBlockN(const uint16_t param, const void *data, const uint16_t len, const EEPROM_Level levels);
+void EEPROM_ReadWearLeveledBlockN(const uint16_t param, void *data, const uint16_t len, const EEPROM_Level levels);
+void EEPROM_WriteWearLeveledBlockN(const uint16_t param, const void *data, const uint16_t len, const EEPROM_Level levels);
+void EEPROM_UpdateWearLeveledBlockN(const uint16_t param, const void *data, const void *previous, const uint16_t len, const EEPROM_Level levels);
+#endif // EEPROM_PER_PARAMETER_LEVELS
+#endif // EEPROM_INCLUDE_BLOCK_FUNCS
+
+#if (EEPROM_INCLUDE_VERSIONED_BLOCK_FUNCS)
+/*
+ * A versioned block is always stored as EEPROM_WEAR_LEVEL_FACTOR
+ * complete copies of the block, and a single status buffer that
+ * records which copy is current, just like a wear-leveled block when
+ * EEPROM_ROTATE_WHOLE_BLOCKS is set. A new value is written into the
+ * next copy, and then made current by a single write to the status
+ * buffer, so a reset during a commit leaves either the old or the new
+ * value of the whole block, never a mix of both. This makes versioned
+ * blocks suitable for structures whose members must stay consistent
+ * with each other, even when the other wear-leveled blocks wear-level
+ * each byte on its own.
+ */
+
+/*
+ * EEPROM_InitVersionedBlock
+ *
+ * Initializes a segment of EEPROM to use for storing versions of a
+ * block of memory, and writes the contents of the buffer to EEPROM.
+ * The segment occupies EE_VERSIONED_BLOCK_SEGMENT_SIZE(len) bytes of
+ * EEPROM.
+ *
+ * param [in]
+ *   The offset into EEPROM where the segment begins.
+ *
+ * data [in]
+ *   A pointer to the buffer containing the initial data to store in
+ *   EEPROM.
+ *
+ * len [in]
+ *   The size of the buffer, in bytes.
+ */
+void EEPROM_InitVersionedBlock(const uint16_t param, const void *data, const uint16_t len);
+
+/*
+ * EEPROM_ReadVersionedBlock
+ *
+ * Reads, and copies the current version of a block stored in EEPROM
+ * into the supplied buffer.
+ *
+ * param [in]
+ *   The offset into EEPROM where the segment begins.
+ *
+ * data [out]
+ *   A pointer to a buffer large enough to contain the block of data
+ *   stored in EEPROM.
+ *
+ * len [in]
+ *   The size of the buffer, in bytes.
+ *
+ * This function may only be invoked if EEPROM_InitVersionedBlock has
+ * previously been invoked on the same segment of EEPROM.
+ */
+void EEPROM_ReadVersionedBlock(const uint16_t param, void *data, const uint16_t len);
+
+/*
+ * EEPROM_CommitVersionedBlock
+ *
+ * Writes the contents of the supplied buffer into the next version of
+ * a block stored in EEPROM, and then makes it the current version. If
+ * the contents are the same as the current version, nothing is
+ * written.
+ *
+ * param [in]
+ *   The offset into EEPROM where the segment begins.
+ *
+ * data [in]
+ *   A pointer to the buffer containing the data to store in EEPROM.
+ *
+ * len [in]
+ *   The size of the buffer, in bytes.
+ *
+ * This function may only be invoked if EEPROM_InitVersionedBlock has
+ * previously been invoked on the same segment of EEPROM.
+ */
+void EEPROM_CommitVersionedBlock(const uint16_t param, const void *data, const uint16_t len);
+#endif // EEPROM_INCLUDE_VERSIONED_BLOCK_FUNCS
+
+#if (EEPROM_INCLUDE_COUNTER_FUNCS)
+/*
+ * A wear-leveled counter stores the number of increments since the
+ * last rollover as a run of cleared bits in one of two unary areas of
+ * EEPROM_COUNTER_UNARY_SIZE bytes, and the number of rollovers as a
+ * block of rotated copies, like a versioned block (or as two copies
+ * when EEPROM_BACKEND = 2). Most increments clear a single bit, which
+ * only needs one write (without an erase, when
+ * EEPROM_SPLIT_PROGRAMMING = 1), and only one in every
+ * EEPROM_COUNTER_UNARY_SIZE * 8 increments writes the number of
+ * rollovers and erases the other unary area.
+ *
+ * A new number of rollovers is only committed by a single write, once
+ * it has been written in full, so an interrupted rollover leaves the
+ * counter at its previous value. An interrupted increment only loses
+ * that increment when the byte it clears a bit of is written without
+ * an erase, which is the case when EEPROM_SPLIT_PROGRAMMING = 1, or
+ * when EEPROM_BACKEND = 2. Otherwise, the byte may be left erased,
+ * losing the up to 7 earlier increments it held.
+ */
+
+/*
+ * EEPROM_InitWearLeveledCounter
+ *
+ * Initializes the EEPROM for storing a wear-leveled counter, and sets
+ * it to an initial value.
+ *
+ * param [in]
+ *   The location of the counter in the EEPROM. The counter occupies
+ *   EE_COUNTER_SEGMENT_SIZE bytes.
+ *
+ * value [in]
+ *   The initial value of the counter.
+ */
+void EEPROM_InitWearLeveledCounter(const uint16_t param, const uint32_t value);
+
+/*
+ * EEPROM_ReadWearLeveledCounter
+ *
+ * Reads the value of a wear-leveled counter.
+ *
+ * This function may only be invoked if EEPROM_InitWearLeveledCounter
+ * has been invoked for the same counter, at some point in the past.
+ *
+ * param [in]
+ *   The location of the counter in the EEPROM.
+ *
+ * Returns:
+ *   The value of the counter.
+ */
+uint32_t EEPROM_ReadWearLeveledCounter(const uint16_t param);
+
+/*
+ * EEPROM_IncrementWearLeveledCounter
+ *
+ * Adds one to the value of a wear-leveled counter.
+ *
+ * This function may only be invoked if EEPROM_InitWearLeveledCounter
+ * has been invoked for the same counter, at some point in the past.
+ *
+ * param [in]
+ *   The location of the counter in the EEPROM.
+ *
+ * Returns:
+ *   The new value of the counter.
+ */
+uint32_t EEPROM_IncrementWearLeveledCounter(const uint16_t param);
+#endif // EEPROM_INCLUDE_COUNTER_FUNCS
+
+#if (EEPROM_INCLUDE_WEAR_FUNCS)
+/*
+ * The wear of a wear-leveled byte or block is estimated from the
+ * number of times its segment has rotated through every level, which
+ * EEPROM_WriteTrackedByte and EEPROM_WriteTrackedBlock count in a
+ * wear-leveled counter, initialized to 0 with
+ * EEPROM_InitWearLeveledCounter alongside the segment. Each rotation
+ * erases and writes every byte of the segment once. Writes made
+ * without these functions are not counted.
+ */
+
+/*
+ * EEPROM_Wear
+ *
+ * The estimated wear of a segment of EEPROM.
+ *
+ * writes
+ *   The number of writes made to the segment that changed its value.
+ *
+ * remaining
+ *   The number of such writes that may still be made before the
+ *   bytes of the segment reach EEPROM_ENDURANCE erase cycles.
+ */
+typedef struct {
+  uint32_t writes;
+  uint32_t remaining;
+} EEPROM_Wear;
+
+#if (EEPROM_INCLUDE_BYTE_FUNCS)
+/*
+ * EEPROM_WriteTrackedByte
+ *
+ * Behaves like EEPROM_WriteWearLeveledByte, and increments the
+ * counter whenever the segment completes a rotation.
+ *
+ * param [in]
+ *   The offset into EEPROM where the wear-leveled segment begins.
+ *
+ * data [in]
+ *   The data to store in EEPROM.
+ *
+ * counter [in]
+ *   The location of the counter of rotations of the segment.
+ */
+void EEPROM_WriteTrackedByte(const uint16_t param, const uint8_t data, const uint16_t counter);
+
+/*
+ * EEPROM_EstimateByteWear
+ *
+ * Estimates the wear of a wear-leveled byte written with
+ * EEPROM_WriteTrackedByte.
+ *
+ * param [in]
+ *   The offset into EEPROM where the wear-leveled segment begins.
+ *
+ * counter [in]
+ *   The location of the counter of rotations of the segment.
+ *
+ * wear [out]
+ *   The structure the estimate is stored into.
+ */
+void EEPROM_EstimateByteWear(const uint16_t param, const uint16_t counter, EEPROM_Wear *wear);
+#endif // EEPROM_INCLUDE_BYTE_FUNCS
+
+/*
+ * EEPROM_WriteTrackedBlock
+ *
+ * Behaves like EEPROM_WriteWearLeveledBlock, and increments the
+ * counter whenever the segment completes a rotation. Unless
+ * EEPROM_ROTATE_WHOLE_BLOCKS is set, each byte of the block rotates
+ * on its own, and has a counter of its own, the counter of byte i
+ * beginning i * EE_COUNTER_SEGMENT_SIZE bytes after the first one.
+ *
+ * param [in]
+ *   The offset into EEPROM where the wear-leveled segment begins.
+ *
+ * data [in]
+ *   A pointer to the buffer containing the data to store in EEPROM.
+ *
+ * len [in]
+ *   The size of the buffer, in bytes.
+ *
+ * counter [in]
+ *   The location of the counters of rotations of the segment, which
+ *   occupy EE_BLOCK_COUNTERS_SIZE(len) bytes.
+ */
+void EEPROM_WriteTrackedBlock(const uint16_t param, const void *data, const uint16_t len, const uint16_t counter);
+
+/*
+ * EEPROM_EstimateBlockWear
+ *
+ * Estimates the wear of a wear-leveled block written with
+ * EEPROM_WriteTrackedBlock. Unless EEPROM_ROTATE_WHOLE_BLOCKS is set,
+ * the estimate is that of the byte that has been written most often.
+ *
+ * param [in]
+ *   The offset into EEPROM where the wear-leveled segment begins.
+ *
+ * len [in]
+ *   The length of the block, in bytes.
+ *
+ * counter [in]
+ *   The location of the counters of rotations of the segment.
+ *
+ * wear [out]
+ *   The structure the estimate is stored into.
+ */
+void EEPROM_EstimateBlockWear(const uint16_t param, const uint16_t len, const uint16_t counter, EEPROM_Wear *wear);
+#endif // EEPROM_INCLUDE_WEAR_FUNCS
+
+#if (EEPROM_INCLUDE_PARAMETER_FUNCS || EEPROM_WRITE_BACK_SIZE)
+/*
+ * EEPROM_Parameter
+ *
+ * Describes a wear-leveled segment of EEPROM, and the memory that
+ * holds its value.
+ *
+ * param
+ *   The offset into EEPROM where the wear-leveled segment begins.
+ *
+ * data
+ *   A pointer to the memory holding the value of the segment.
+ *
+ * len
+ *   The size of the value, in bytes. A segment initialized with
+ *   EEPROM_InitWearLeveledByte has a len of 1.
+ *
+ * levels
+ *   Only present when EEPROM_PER_PARAMETER_LEVELS is set. The number
+ *   of levels the segment was initialized with, or 0 if it uses
+ *   EEPROM_WEAR_LEVEL_FACTOR levels.
+ */
+typedef struct {
+  uint16_t param;
+  void *data;
+  uint16_t len;
+#if (EEPROM_PER_PARAMETER_LEVELS)
+  EEPROM_Level levels;
+#endif // EEPROM_PER_PARAMETER_LEVELS
+} EEPROM_Parameter;
+#endif // EEPROM_INCLUDE_PARAMETER_FUNCS || EEPROM_WRITE_BACK_SIZE
+
+#if (EEPROM_INCLUDE_PARAMETER_FUNCS)
+/*
+ * EEPROM_ReadWearLeveledParameters
+ *
+ * Reads the data currently stored in each of a table of wear-leveled
+ * segments of EEPROM into memory. This is equivalent to invoking
+ * EEPROM_ReadWearLeveledByte or EEPROM_ReadWearLeveledBlock for each
+ * segment, but every status buffer is read once in order, without a
+ * search, and when EEPROM_CACHE_SIZE is set, the current location of
+ * each segment is remembered, so later writes do not search again.
+ *
+ * params [in]
+ *   A pointer to the table of segments to read. Segments should be
+ *   listed in the order they occur in EEPROM.
+ *
+ * count [in]
+ *   The number of segments in the table.
+ *
+ * This function may only be invoked if each segment has previously
+ * been initialized with EEPROM_InitWearLeveledByte or
+ * EEPROM_InitWearLeveledBlock.
+ */
+void EEPROM_ReadWearLeveledParameters(const EEPROM_Parameter *params, const uint8_t count);
+
+/*
+ * EEPROM_InitWearLeveledParametersIfNeeded
+ *
+ * Reads the data currently stored in each of a table of wear-leveled
+ * segments of EEPROM into memory, like
+ * EEPROM_ReadWearLeveledParameters, but initializes any segment that
+ * has not been initialized yet with the value in memory instead, like
+ * EEPROM_InitWearLeveledBlock. This may be invoked every time the
+ * device is powered on, in place of deciding whether to initialize or
+ * read each segment.
+ *
+ * A signature of the layout of the table, and of the configuration
+ * in eeprom.mk that affects the format of every segment, is stored in
+ * EEPROM. If the stored signature does not match, every segment is
+ * initialized, and the signature is stored afterwards. Otherwise, the
+ * status buffer of each segment is checked, and only a segment whose
+ * status buffer holds values this library could not have written is
+ * initialized. When EEPROM_BACKEND = 2, there are no status buffers,
+ * and only the signature is checked.
+ *
+ * Checking a status buffer cannot tell whether it was erased after the
+ * signature was stored for a segment of 3 levels or less, or when
+ * EEPROM_BIT_CLEARING_STATUS = 1, since an erased status buffer then
+ * holds values this library could have written. Only the signature
+ * guards those segments.
+ *
+ * params [in]
+ *   A pointer to the table of segments. The data of each segment must
+ *   hold the value to initialize it with, and is replaced with the
+ *   value read from EEPROM.
+ *
+ * count [in]
+ *   The number of segments in the table.
+ *
+ * signature [in]
+ *   The offset into EEPROM where the signature is stored, which
+ *   occupies EE_SIGNATURE_SIZE bytes that must not overlap any segment.
+ *
+ * Returns:
+ *   The number of segments that were initialized.
+ */
+#define EE_SIGNATURE_SIZE 2
+uint8_t EEPROM_InitWearLeveledParametersIfNeeded(const EEPROM_Parameter *params, const uint8_t count, const uint16_t signature);
+#endif // EEPROM_INCLUDE_PARAMETER_FUNCS
+
+#if (EEPROM_WRITE_BACK_SIZE)
+/*
+ * EEPROM_InitWriteBack
+ *
+ * Sets the table of wear-leveled parameters whose values are changed
+ * in memory, and only written to EEPROM when flushed. The memory each
+ * parameter points to holds its latest value, so it may be changed
+ * any number of times between flushes, and only the final value will
+ * be written. Initially, no parameters are marked as changed.
+ *
+ * params [in]
+ *   A pointer to the table of parameters, which must remain valid
+ *   while it is in use. Each parameter must have been initialized
+ *   with EEPROM_InitWearLeveledBlock.
+ *
+ * count [in]
+ *   The number of parameters in the table. Only the first
+ *   EEPROM_WRITE_BACK_SIZE parameters are used if there are more.
+ */
+void EEPROM_InitWriteBack(const EEPROM_Parameter *params, const uint8_t count);
+
+/*
+ * EEPROM_MarkDirty
+ *
+ * Marks the value in memory of a parameter as changed, so that it
+ * will be written to EEPROM by the next flush.
+ *
+ * index [in]
+ *   The index of the parameter in the table passed to
+ *   EEPROM_InitWriteBack. An index that is not less than the number
+ *   of parameters in use is ignored.
+ */
+void EEPROM_MarkDirty(const uint8_t index);
+
+/*
+ * EEPROM_Flush
+ *
+ * Writes the value of every parameter marked as changed to EEPROM,
+ * using EEPROM_WriteWearLeveledBlock, and marks them as unchanged.
+ */
+void EEPROM_Flush(void);
+
+/*
+ * EEPROM_FlushIfIdle
+ *
+ * Writes the value of the first parameter marked as changed to
+ * EEPROM, but only if the EEPROM is not busy programming, and no
+ * queued writes are pending. This may be invoked on every iteration
+ * of a main loop, to write changed parameters one at a time.
+ *
+ * Returns:
+ *   Non-zero if any parameters are still marked as changed.
+ */
+uint8_t EEPROM_FlushIfIdle(void);
+#endif // EEPROM_WRITE_BACK_SIZE
+
+#if (EEPROM_LOG_SIZE)
+/*
+ * The log stores the values of up to EEPROM_LOG_KEYS keys, numbered
+ * from 0, as records appended to EEPROM_LOG_SIZE bytes of EEPROM
+ * beginning at EEPROM_LOG_BEGIN. Writing a value only appends a single
+ * record, so the writes of every key are spread across the whole log,
+ * and each value may have a different length, from 0 to 255 bytes.
+ * The location of the latest record of each key is kept in RAM, and
+ * is rebuilt by EEPROM_LoadLog when the device is powered on. Each
+ * record occupies the length of its value plus 3 bytes.
+ *
+ * Half of the log holds the current records, and compacting the log
+ * copies the latest record of every key into the other half. A
+ * compaction is made in steps, each of which erases a few bytes (a
+ * page of an external EEPROM) of the other half, copies the record of
+ * one key, or makes the other half current. Once the free space of
+ * the current half drops below a third of its size plus the size of
+ * the latest records, each write of a value also takes steps going over
+ * about four times as many bytes as the value's record, which finishes
+ * the compaction before the current half is full, and
+ * EEPROM_CompactLogStep may take more steps while the device is idle.
+ * A write only waits for a whole compaction when the current half has
+ * no room left for the new value.
+ */
+
+/*
+ * EEPROM_InitLog
+ *
+ * Erases the log, leaving no value stored for any key.
+ *
+ * This function only needs to be invoked once, when EEPROM_LoadLog
+ * finds no log in EEPROM.
+ */
+void EEPROM_InitLog(void);
+
+/*
+ * EEPROM_LoadLog
+ *
+ * Locates the latest record of every key in the log. A record whose
+ * write was interrupted is discarded.
+ *
+ * Returns:
+ *   Zero if the EEPROM holds no log, in which case EEPROM_InitLog must
+ *   be invoked before any other log function.
+ */
+uint8_t EEPROM_LoadLog(void);
+
+/*
+ * EEPROM_ReadLogValue
+ *
+ * Reads the value of a key from the log into the supplied buffer. If
+ * the stored value is shorter than the buffer, the rest of the buffer
+ * is left unchanged, and if it is longer, only the beginning of the
+ * value is read.
+ *
+ * key [in]
+ *   The key, which should be less than EEPROM_LOG_KEYS.
+ *
+ * data [out]
+ *   A pointer to the buffer to read the value into.
+ *
+ * len [in]
+ *   The size of the buffer, in bytes.
+ *
+ * Returns:
+ *   Zero if no value is stored for the key, or if the key is not less
+ *   than EEPROM_LOG_KEYS.
+ */
+uint8_t EEPROM_ReadLogValue(const uint8_t key, void *data, const uint8_t len);
+
+/*
+ * EEPROM_WriteLogValue
+ *
+ * Appends a record holding a new value of a key to the log, unless the
+ * value is the same as the one currently stored, and may take steps
+ * of a compaction. If the log has no room for the record, the log is
+ * compacted all at once, and the new value takes the place of the
+ * previous value of the key.
+ *
+ * key [in]
+ *   The key, which should be less than EEPROM_LOG_KEYS.
+ *
+ * data [in]
+ *   A pointer to the buffer containing the value.
+ *
+ * len [in]
+ *   The size of the value, in bytes.
+ *
+ * Returns:
+ *   Zero if the latest values of every key would not fit into half of
+ *   the log, in which case the previous value of the key is kept, or
+ *   if the key is not less than EEPROM_LOG_KEYS.
+ */
+uint8_t EEPROM_WriteLogValue(const uint8_t key, const void *data, const uint8_t len);
+
+/*
+ * EEPROM_CompactLog
+ *
+ * Copies the latest record of every key into the other half of the
+ * log, which frees the space of every older record, finishing the
+ * compaction in progress, if any, or making a whole new one.
+ */
+void EEPROM_CompactLog(void);
+
+/*
+ * EEPROM_CompactLogStep
+ *
+ * Takes the next step of the compaction in progress, or starts a new
+ * one. This may be invoked while the device is idle, such as when
+ * EEPROM_LogFree is running low, so that writes do not have to wait
+ * for a compaction later. If the device is reset before the
+ * compaction is complete, the current half of the log is kept, and
+ * the compaction has to start over.
+ *
+ * Returns:
+ *   Zero once the compaction is complete.
+ */
+uint8_t EEPROM_CompactLogStep(void);
+
+/*
+ * EEPROM_LogFree
+ *
+ * Returns:
+ *   The number of bytes that may be appended to the log before it
+ *   has to be compacted.
+ */
+uint16_t EEPROM_LogFree(void);
+#endif // EEPROM_LOG_SIZE
+
+#if (EEPROM_PROFILING)
+/*
+ * The functions measured when EEPROM_PROFILING is set, which are
+ * passed to EEPROM_GetProfileStats. The functions that take the
+ * number of levels of a segment, and the functions generated for the
+ * parameters listed in EEPROM_PARAMETERS when EEPROM_PER_PARAMETER_LEVELS
+ * is set, are not measured.
+ */
+enum {
+  EE_PROFILE_READ_BYTE,
+  EE_PROFILE_WRITE_BYTE,
+  EE_PROFILE_READ_BLOCK,
+  EE_PROFILE_WRITE_BLOCK,
+  EE_PROFILE_READ_VERSIONED_BLOCK,
+  EE_PROFILE_COMMIT_VERSIONED_BLOCK,
+  EE_PROFILE_INCREMENT_COUNTER,
+  EE_PROFILE_WRITE_LOG_VALUE,
+  EE_PROFILE_COUNT
+};
+
+/*
+ * EEPROM_ProfileStats
+ *
+ * The calls to a function since the program started, or since the
+ * last call to EEPROM_ResetProfileStats. A call made by another
+ * measured function, such as the block write made when a counter
+ * rolls over, is only counted as part of the outer call.
+ *
+ * calls
+ *   The number of calls.
+ *
+ * skipped
+ *   The number of calls to a write function that did not write any
+ *   byte of EEPROM, because the data stored was already the same.
+ *
+ * min, max
+ *   The fewest and most ticks of EEPROM_PROFILE_TIMER taken by a call.
+ *
+ * total
+ *   The number of ticks taken by every call.
+ */
+typedef struct {
+  uint32_t calls;
+  uint32_t skipped;
+  uint16_t min;
+  uint16_t max;
+  uint32_t total;
+} EEPROM_ProfileStats;
+
+/*
+ * EEPROM_GetProfileStats
+ *
+ * Copies the measurements of the calls to one function.
+ *
+ * api [in]
+ *   The function, one of EE_PROFILE_READ_BYTE, etc.
+ *
+ * stats [out]
+ *   The structure the measurements are copied into.
+ */
+void EEPROM_GetProfileStats(const uint8_t api, EEPROM_ProfileStats *stats);
+
+/*
+ * EEPROM_ResetProfileStats
+ *
+ * Sets the measurements of every function to zero.
+ */
+void EEPROM_ResetProfileStats(void);
+#endif // EEPROM_PROFILING
+
+/*
+ * The functions generated for each parameter, and for each scalar
+ * type, are forced inline, so that the offset, length, and number of
+ * levels of each parameter are constant folded, and when each byte of
+ * a block is wear-leveled on its own, the loop over those bytes can
+ * be unrolled.
+ */
+#define EE_INLINE static inline __attribute__((always_inline))
+
+#if (EEPROM_INCLUDE_BLOCK_FUNCS)
+/*
+ * EEPROM_InitWearLeveledU16, EEPROM_InitWearLeveledU32,
+ * EEPROM_InitWearLeveledFloat
+ * EEPROM_ReadWearLeveledU16, EEPROM_ReadWearLeveledU32,
+ * EEPROM_ReadWearLeveledFloat
+ * EEPROM_WriteWearLeveledU16, EEPROM_WriteWearLeveledU32,
+ * EEPROM_WriteWearLeveledFloat
+ *
+ * These functions behave like EEPROM_InitWearLeveledBlock,
+ * EEPROM_ReadWearLeveledBlock, and EEPROM_WriteWearLeveledBlock on a
+ * block the size of a uint16_t, uint32_t, or float, but take and
+ * return the value itself:
+ *
+ *   void EEPROM_InitWearLeveled<suffix>(const uint16_t param, const type data);
+ *   type EEPROM_ReadWearLeveled<suffix>(const uint16_t param);
+ *   void EEPROM_WriteWearLeveled<suffix>(const uint16_t param, const type data);
+ *
+ * Each segment occupies EE_BLOCK_SEGMENT_SIZE(sizeof(type)) bytes of
+ * EEPROM, and may also be accessed with the block functions.
+ *
+ * EEPROM_InitWearLeveledValue(param, data)
+ * EEPROM_ReadWearLeveledValue(param, data)
+ * EEPROM_WriteWearLeveledValue(param, data)
+ *
+ * These macros select the function above matching the type of data,
+ * which must be exactly uint16_t, uint32_t, or float (so an
+ * expression that is promoted to int must be cast). The read macro
+ * stores the value read into data, which must be an lvalue.
+ */
+#if (EEPROM_ROTATE_WHOLE_BLOCKS || !EEPROM_INCLUDE_BYTE_FUNCS || EEPROM_BACKEND)
+#define EE_SCALAR_ACCESSORS(suffix, type)                               \
+  EE_INLINE void EEPROM_InitWearLeveled##suffix(const uint16_t param, const type data) { \
+    EEPROM_InitWearLeveledBlock(param, &data, sizeof(type));            \
+  }                                                                     \
+  EE_INLINE type EEPROM_ReadWearLeveled##suffix(const uint16_t param) { \
+    type data;                                                          \
+    EEPROM_ReadWearLeveledBlock(param, &data, sizeof(type));            \
+    return data;                                                        \
+  }                                                                     \
+  EE_INLINE void EEPROM_WriteWearLeveled##suffix(const uint16_t param, const type data) { \
+    EEPROM_WriteWearLeveledBlock(param, &data, sizeof(type));           \
+  }
+#else // EEPROM_ROTATE_WHOLE_BLOCKS || !EEPROM_INCLUDE_BYTE_FUNCS || EEPROM_BACKEND
+#define EE_SCALAR_ACCESSORS(suffix, type)                               \
+  EE_INLINE void EEPROM_InitWearLeveled##suffix(const uint16_t param, const type data) { \
+    for (uint8_t i = 0; i < sizeof(type); ++i)                          \
+      EEPROM_InitWearLeveledByte(param + i * EE_BYTE_SEGMENT_SIZE,      \
+                                 ((const uint8_t *)&data)[i]);          \
+  }                                                                     \
+  EE_INLINE type EEPROM_ReadWearLeveled##suffix(const uint16_t param) { \
+    type data;                                                          \
+    for (uint8_t i = 0; i < sizeof(type); ++i)                          \
+      ((uint8_t *)&data)[i] =                                           \
+        EEPROM_ReadWearLeveledByte(param + i * EE_BYTE_SEGMENT_SIZE);   \
+    return data;                                                        \
+  }                                                                     \
+  EE_INLINE void EEPROM_WriteWearLeveled##suffix(const uint16_t param, const type data) { \
+    for (uint8_t i = 0; i < sizeof(type); ++i)                          \
+      EEPROM_WriteWearLeveledByte(param + i * EE_BYTE_SEGMENT_SIZE,     \
+                                  ((const uint8_t *)&data)[i]);         \
+  }
+#endif // EEPROM_ROTATE_WHOLE_BLOCKS || !EEPROM_INCLUDE_BYTE_FUNCS || EEPROM_BACKEND
+EE_SCALAR_ACCESSORS(U16, uint16_t)
+EE_SCALAR_ACCESSORS(U32, uint32_t)
+EE_SCALAR_ACCESSORS(Float, float)
+#undef EE_SCALAR_ACCESSORS
+
+#define EE_SCALAR_SELECT(function, data) \
+  _Generic((data), uint16_t: function##U16, uint32_t: function##U32, float: function##Float)
+#define EEPROM_InitWearLeveledValue(param, data) \
+  EE_SCALAR_SELECT(EEPROM_InitWearLeveled, (data))((param), (data))
+#define EEPROM_ReadWearLeveledValue(param, data) \
+  ((data) = EE_SCALAR_SELECT(EEPROM_ReadWearLeveled, (data))((param)))
+#define EEPROM_WriteWearLeveledValue(param, data) \
+  EE_SCALAR_SELECT(EEPROM_WriteWearLeveled, (data))((param), (data))
 #endif // EEPROM_INCLUDE_BLOCK_FUNCS
+
+#ifdef EEPROM_PARAMETERS
+#if (EEPROM_PER_PARAMETER_LEVELS)
+#define EE_CALL(function, levels, ...) function##N(__VA_ARGS__, (levels))
+#else // EEPROM_PER_PARAMETER_LEVELS
+#define EE_CALL(function, levels, ...) function(__VA_ARGS__)
+#endif // EEPROM_PER_PARAMETER_LEVELS
+#if (EEPROM_ROTATE_WHOLE_BLOCKS || !EEPROM_INCLUDE_BYTE_FUNCS || (EEPROM_BACKEND && EEPROM_INCLUDE_BLOCK_FUNCS))
+#define EE_LAYOUT_ACCESSORS(name, type, ...)                            \
+  EE_INLINE void EEPROM_Init##name(const type *data) {                  \
+    EE_CALL(EEPROM_InitWearLeveledBlock, EE_LEVELS(__VA_ARGS__),        \
+            EE_OFFSET(name), data, sizeof(type));                       \
+  }                                                                     \
+  EE_INLINE void EEPROM_Read##name(type *data) {                        \
+    EE_CALL(EEPROM_ReadWearLeveledBlock, EE_LEVELS(__VA_ARGS__),        \
+            EE_OFFSET(name), data, sizeof(type));                       \
+  }                                                                     \
+  EE_INLINE void EEPROM_Write##name(const type *data) {                 \
+    EE_CALL(EEPROM_WriteWearLeveledBlock, EE_LEVELS(__VA_ARGS__),       \
+            EE_OFFSET(name), data, sizeof(type));                       \
+  }                                                                     \
+  EE_INLINE void EEPROM_Update##name(const type *data, const type *previous) { \
+    EE_CALL(EEPROM_UpdateWearLeveledBlock, EE_LEVELS(__VA_ARGS__),      \
+            EE_OFFSET(name), data, previous, sizeof(type));             \
+  }
+#else // EEPROM_ROTATE_WHOLE_BLOCKS || !EEPROM_INCLUDE_BYTE_FUNCS || (EEPROM_BACKEND && EEPROM_INCLUDE_BLOCK_FUNCS)
+#define EE_LAYOUT_ACCESSORS(name, type, ...)                            \
+  EE_INLINE void EEPROM_Init##name(const type *data) {                  \
+    for (uint16_t i = 0; i < sizeof(type); ++i)                         \
+      EE_CALL(EEPROM_InitWearLeveledByte, EE_LEVELS(__VA_ARGS__),       \
+              EE_OFFSET(name) + i * EE_BYTE_SEGMENT_SIZE_N(EE_LEVELS(__VA_ARGS__)), \
+              ((const uint8_t *)data)[i]);                              \
+  }                                                                     \
+  EE_INLINE void EEPROM_Read##name(type *data) {                        \
+    for (uint16_t i = 0; i < sizeof(type); ++i)                         \
+      ((uint8_t *)data)[i] =                                            \
+        EE_CALL(EEPROM_ReadWearLeveledByte, EE_LEVELS(__VA_ARGS__),     \
+                EE_OFFSET(name) + i * EE_BYTE_SEGMENT_SIZE_N(EE_LEVELS(__VA_ARGS__))); \
+  }                                                                     \
+  EE_INLINE void EEPROM_Write##name(const type *data) {                 \
+    for (uint16_t i = 0; i < sizeof(type); ++i)                         \
+      EE_CALL(EEPROM_WriteWearLeveledByte, EE_LEVELS(__VA_ARGS__),      \
+              EE_OFFSET(name) + i * EE_BYTE_SEGMENT_SIZE_N(EE_LEVELS(__VA_ARGS__)), \
+              ((const uint8_t *)data)[i]);                              \
+  }                                                                     \
+  EE_INLINE void EEPROM_Update##name(const type *data, const type *previous) { \
+    for (uint16_t i = 0; i < sizeof(type); ++i)                         \
+      if (((const uint8_t *)data)[i] != ((const uint8_t *)previous)[i]) \
+        EE_CALL(EEPROM_WriteWearLeveledByte, EE_LEVELS(__VA_ARGS__),    \
+                EE_OFFSET(name) + i * EE_BYTE_SEGMENT_SIZE_N(EE_LEVELS(__VA_ARGS__)), \
+                ((const uint8_t *)data)[i]);                            \
+  }
+#endif // EEPROM_ROTATE_WHOLE_BLOCKS || !EEPROM_INCLUDE_BYTE_FUNCS || (EEPROM_BACKEND && EEPROM_INCLUDE_BLOCK_FUNCS)
+EEPROM_PARAMETERS(EE_LAYOUT_ACCESSORS)
+#undef EE_LAYOUT_ACCESSORS
+#undef EE_CALL
+#endif // EEPROM_PARAMETERS
+#undef EE_INLINE
@@ -14,12 +14,269 @@ EEPROM_WEAR_LEVEL_FACTOR = 8
 #  1 = Include functions for operating on blocks of memory
 EEPROM_INCLUDE_BLOCK_FUNCS = 1
 
+# Flag for allowing each wear-leveled parameter to distribute its
+# writes across its own number of levels, rather than across
+# EEPROM_WEAR_LEVEL_FACTOR levels. Parameters that are rarely written
+# may then occupy as little as 2 bytes of EEPROM per byte of data,
+# leaving more EEPROM for parameters that are written often. This
+# includes the functions EEPROM_InitWearLeveledByteN, etc., which take
+# the number of levels as an extra argument, and allows the number of
+# levels to be given for each parameter listed in EEPROM_PARAMETERS.
+#  0 = Every parameter uses EEPROM_WEAR_LEVEL_FACTOR levels
+#  1 = Each parameter may use its own number of levels
+EEPROM_PER_PARAMETER_LEVELS = 0
+
+# Flag for allowing a segment to have more than 255 levels, so that a
+# parameter written very often may distribute its writes across
+# hundreds or thousands of bytes of a large EEPROM. The status buffer
+# still holds a byte per level, so the format of a segment does not
+# change, but the number of levels is stored in 16 bits, which makes
+# the code slightly larger and each entry of the cache use one more
+# byte of RAM. When EEPROM_BIT_CLEARING_STATUS = 0, the number of
+# levels must not be a multiple of 256, since a rotation would then
+# leave every element of the status buffer holding the value it held
+# in the previous rotation.
+# Note: The binary search (EEPROM_BINARY_SEARCH) is recommended when
+#       segments have this many levels.
+#  0 = Every segment has between 1 and 255 levels
+#  1 = Every segment has between 1 and 65535 levels
+EEPROM_WIDE_LEVELS = 0
+
+# Flag for selecting how the functions for operating on blocks of
+# memory wear-level a block. When each byte is wear-leveled on its
+# own, a block of len bytes occupies len * EEPROM_WEAR_LEVEL_FACTOR * 2
+# bytes of EEPROM, and only the bytes that change are written. When
+# the whole block is rotated, the block keeps a single status buffer,
+# occupies (len + 1) * EEPROM_WEAR_LEVEL_FACTOR bytes of EEPROM, is
+# located with a single search and read with a single block read (a
+# sequential read on an external EEPROM), and a complete copy of the
+# block is written whenever any of its bytes change.
+#  0 = Wear-level each byte of a block on its own
+#  1 = Rotate each block as a whole
+EEPROM_ROTATE_WHOLE_BLOCKS = 0
+
+# Flag for including functions for versioned blocks of memory, which
+# are always rotated as a whole, regardless of
+# EEPROM_ROTATE_WHOLE_BLOCKS. A new value of a versioned block is
+# committed with a single write to its status buffer, after every byte
+# of the value has been written, so a reset during a write never
+# leaves part of the block updated. Each versioned block of len bytes
+# occupies (len + 1) * EEPROM_WEAR_LEVEL_FACTOR bytes of EEPROM.
+# Versioned blocks are not supported when EEPROM_BACKEND = 2.
+#  0 = Do not include functions for versioned blocks
+#  1 = Include functions for versioned blocks
+EEPROM_INCLUDE_VERSIONED_BLOCK_FUNCS = 0
+
 # Flag for including functions for wear-leveling single bytes of
 # memory.
 #  0 = Do not include functions for operating on blocks of memory
 #  1 = Include functions for operating on blocks of memory
 EEPROM_INCLUDE_BYTE_FUNCS = 1
 
+# Flag for including functions for wear-leveled counters, which only
+# clear a single bit of EEPROM for most increments, instead of
+# rewriting the bytes of a block that change, and their metadata. Each
+# counter uses two unary areas of EEPROM_COUNTER_UNARY_SIZE bytes, and
+# the number of rollovers is only written once every
+# EEPROM_COUNTER_UNARY_SIZE * 8 increments, committed by a single
+# write so that an interrupted rollover keeps the previous value.
+#  0 = Do not include functions for wear-leveled counters
+#  1 = Include functions for wear-leveled counters
+EEPROM_INCLUDE_COUNTER_FUNCS = 0
+EEPROM_COUNTER_UNARY_SIZE = 8
+
+# Flag for including functions that estimate how worn a wear-leveled
+# byte or block is, for telemetry that flags a device before its
+# EEPROM wears out. Writes made with EEPROM_WriteTrackedByte() or
+# EEPROM_WriteTrackedBlock() count each rotation of the segment
+# through every level in a wear-leveled counter, from which the
+# number of writes made, and the number of writes left before the
+# segment reaches EEPROM_ENDURANCE erase cycles (from the datasheet),
+# are estimated. Unless EEPROM_ROTATE_WHOLE_BLOCKS = 1, each byte of a
+# block rotates on its own and has a counter of its own (see
+# EE_BLOCK_COUNTERS_SIZE). This requires EEPROM_INCLUDE_COUNTER_FUNCS =
+# 1, and is not supported when EEPROM_BACKEND = 2.
+#  0 = Do not include functions for estimating wear
+#  1 = Include functions for estimating wear
+EEPROM_INCLUDE_WEAR_FUNCS = 0
+EEPROM_ENDURANCE = 100000
+
+# Flag for including functions for operating on a table of
+# wear-leveled parameters at once, such as reading the current value
+# of every parameter when the device is powered on, and initializing
+# only the parameters that have not been initialized yet.
+#  0 = Do not include functions for operating on tables of parameters
+#  1 = Include functions for operating on tables of parameters
+EEPROM_INCLUDE_PARAMETER_FUNCS = 0
+
+# EEPROM_WRITE_BACK_SIZE determines the number of wear-leveled
+# parameters whose values may be changed in memory any number of
+# times, and only written to EEPROM when EEPROM_Flush() or
+# EEPROM_FlushIfIdle() is invoked. Each parameter uses 1 bit of RAM,
+# and the functions for operating on blocks of memory must be
+# included.
+#  0 = Do not include functions for writing parameters back later
+#  1-255 = Number of parameters that may be written back later
+EEPROM_WRITE_BACK_SIZE = 0
+
+# EEPROM_LOG_SIZE determines the number of bytes of EEPROM, beginning
+# at EEPROM_LOG_BEGIN, used by a log of key/value records. Instead of
+# giving every parameter a fixed segment of its own, each new value of
+# any of EEPROM_LOG_KEYS keys is appended to the log, so that writes
+# are spread across the whole log, no matter which keys are written.
+# Half of the log holds the current records, and as it fills up the
+# latest record of every key is copied into the other half, a step at
+# a time (see EEPROM_CompactLogStep()). Each key uses 2 bytes of RAM.
+# The log must not overlap any wear-leveled parameter.
+#  0 = Do not include functions for the log
+#  8-n = Number of bytes of EEPROM used by the log
+EEPROM_LOG_SIZE = 0
+EEPROM_LOG_BEGIN = 0
+EEPROM_LOG_KEYS = 16
+
+# EEPROM_CACHE_SIZE determines the number of wear-leveled segments
+# whose current location is remembered in RAM. The status buffer of a
+# cached segment is only scanned the first time it is accessed, after
+# which reads and writes locate the current value without touching
+# the metadata stored in EEPROM. Each entry uses 3 bytes of RAM (4
+# bytes when EEPROM_WIDE_LEVELS = 1), and segments accessed after the
+# cache is full fall back to scanning.
+# Note: Unless EEPROM_ROTATE_WHOLE_BLOCKS is set, each byte of a block
+#       is its own segment, and uses its own cache entry.
+#  0 = Disable the cache
+#  1-255 = Number of segments to cache
+EEPROM_CACHE_SIZE = 0
+
+# Flag for selecting how the current location of a wear-leveled
+# segment is found in its status buffer. A linear search reads up to
+# EEPROM_WEAR_LEVEL_FACTOR * 2 bytes of EEPROM, while a binary search
+# always reads 1 + log2(EEPROM_WEAR_LEVEL_FACTOR) bytes, at the cost
+# of slightly larger code.
+# Note: The binary search is recommended when EEPROM_WEAR_LEVEL_FACTOR
+#       is 16 or more.
+#  0 = Use a linear search
+#  1 = Use a binary search
+EEPROM_BINARY_SEARCH = 0
+
+# EEPROM_WRITE_QUEUE_SIZE determines the number of writes to EEPROM
+# that may be waiting to be performed in the background. When the
+# queue is enabled, writing a wear-leveled byte or block only adds the
+# bytes to be programmed to the queue, and returns immediately, unless
+# the queue is full. The queue is drained by the EEPROM Ready
+# interrupt, so global interrupts must be enabled. Reads of addresses
+# with queued writes return the queued values. Each entry uses 3 bytes
+# of RAM.
+# Note: When running on a computer, queued writes are only performed
+#       by EEPROM_PollWrites() or EEPROM_FlushWrites(), or when room
+#       has to be made in a full queue.
+#  0 = Disable the queue, and wait for each write to finish
+#  1-255 = Number of writes that may be queued
+EEPROM_WRITE_QUEUE_SIZE = 0
+
+# EEPROM_DEFERRED_WRITES determines the number of writes of
+# wear-leveled bytes that interrupt handlers may make, with
+# EEPROM_DeferWearLeveledByte(), until the main program performs them
+# with EEPROM_ApplyDeferredWrites(). The wear-leveling functions are
+# not reentrant, so they must never be called from an interrupt
+# handler that may interrupt another call, and deferring the writes
+# avoids having to disable interrupts around every call made by the
+# main program. Adding a deferred write only disables interrupts for
+# a few cycles. Each entry uses 3 bytes of RAM.
+# Note: Whether or not this is enabled, interrupts are only disabled
+#       briefly by a write: for the few cycles between setting EEMPE
+#       and EEPE, and when EEPROM_WRITE_QUEUE_SIZE is set, while a
+#       write is added to or taken from the queue.
+#  0 = Disable deferred writes
+#  1-255 = Number of writes that may be deferred
+EEPROM_DEFERRED_WRITES = 0
+
+# Flag for selecting how each byte of EEPROM is programmed on an AVR.
+# Erasing a byte sets all of its bits, and writing a byte can only
+# clear bits, so a byte that is being changed to 0xFF only needs to be
+# erased, and a byte that only has bits being cleared only needs to be
+# written. Each of these operations takes about 1.8 ms, while an
+# atomic erase and write takes about 3.4 ms.
+# Note: Not every AVR supports separate erase and write operations.
+#  0 = Always use an atomic erase and write
+#  1 = Erase only, or write only, whenever possible
+EEPROM_SPLIT_PROGRAMMING = 0
+
+# Flag for selecting how the CPU waits for the EEPROM of an AVR to
+# finish a write before it can be accessed again. Instead of spinning
+# at full power for the 1.8 to 3.4 ms of each write, the CPU may be put
+# into idle sleep, and woken by the EEPROM Ready interrupt. When the
+# CPU is woken by another interrupt, it goes back to sleep, unless the
+# write has finished. The sleep mode the application selected is
+# restored afterwards. Waits made with global interrupts disabled
+# still spin. Unless EEPROM_WRITE_QUEUE_SIZE is set, the EEPROM Ready
+# interrupt handler may be left to the application, which must then
+# clear EERIE in EECR from its handler. This setting has no effect when
+# compiling for a computer.
+#  0 = Spin while waiting for a write to finish
+#  1 = Sleep while waiting for a write to finish, and define the EEPROM
+#      Ready interrupt handler (EE_READY_vect) in this library
+#  2 = Sleep while waiting for a write to finish, and leave the EEPROM
+#      Ready interrupt handler to the application
+EEPROM_SLEEP_WHILE_PROGRAMMING = 0
+
+# Flag for selecting how the status buffer of a wear-leveled segment
+# records which level is current. Storing a count in every element,
+# as described in Atmel's AVR101 application note, usually changes
+# bits in both directions, so every update of the status buffer needs
+# an atomic erase and write. Storing the number of rotations of the
+# segment as a run of cleared bits only ever clears one more bit of
+# an element, except that every ninth rotation erases each element
+# back to 0xFF. Combined with EEPROM_SPLIT_PROGRAMMING = 1, each
+# update of a status buffer then takes a single write only (or erase
+# only) operation. Changing this setting requires every wear-leveled
+# parameter to be initialized again.
+#  0 = Store a count in each element of the status buffer
+#  1 = Store a run of cleared bits in each element of the status buffer
+EEPROM_BIT_CLEARING_STATUS = 0
+
+# Flag for measuring how long each call to the functions that read and
+# write wear-leveled data takes, and how often a write is skipped
+# because the data stored is already the same. For each function, the
+# number of calls and skipped writes, and the minimum, maximum and
+# total number of timer ticks taken, are kept. See
+# EEPROM_GetProfileStats(). The ticks are read from
+# EEPROM_PROFILE_TIMER, which must be set to the register of a free
+# running 16-bit timer set up by the application, such as TCNT1 on an
+# ATmega328P (the timers of an ATtiny85 are all 8-bit, and cannot be
+# used). With a prescaler of 1, the ticks are CPU cycles, but calls
+# that take longer than 65535 ticks are measured modulo 65536, so a
+# larger prescaler may be needed to catch the longest writes. When
+# compiling for a computer, the ticks are microseconds, and
+# EEPROM_PROFILE_TIMER is not used.
+#  0 = Do not measure the calls
+#  1 = Measure the calls
+EEPROM_PROFILING = 0
+EEPROM_PROFILE_TIMER =
+
+# The memory the parameters are stored in. An external EEPROM or FRAM
+# is accessed through EEPROM_BackendRead(), EEPROM_BackendReadBlock() and
+# EEPROM_BackendWritePage(), which must be provided by the application
+# when compiling for an AVR (see eeprom.h). Since each write cycle of
+# an external EEPROM writes a whole page, the writes made by each call
+# to a wear-leveling function to consecutive bytes of the same page
+# are combined into a single page write, and only bytes that are
+# actually written are sent. FRAM does not wear out, so with FRAM
+# every parameter is stored once, without any metadata, and read and
+# written directly. EEPROM_WRITE_QUEUE_SIZE and
+# EEPROM_SPLIT_PROGRAMMING only apply to the internal EEPROM, and
+# EEPROM_CACHE_SIZE does not apply to FRAM.
+#  0 = The internal EEPROM of the AVR
+#  1 = An external EEPROM, such as a 24LC256 connected over I2C
+#  2 = An external FRAM, such as an MB85RC256V connected over I2C
+EEPROM_BACKEND = 0
+
+# The page size of the external EEPROM, which must be a power of two
+# (and is not used for FRAM), and the size of the external memory,
+# which is used to check that every parameter fits. These settings
+# have no effect when EEPROM_BACKEND = 0.
+EEPROM_PAGE_SIZE = 64
+EEPROM_EXTERNAL_SIZE = 32768
+
 # For simulation purposes, this library will also compile and run on a
 # computer. When running on a computer, reads and writes to the EEPROM
 # will be simulated using an array named "eeprom" and a function named
@@ -28,6 +285,19 @@ EEPROM_INCLUDE_BYTE_FUNCS = 1
 # simulated EEPROM, modify EEPROM_SIMULATED_SIZE below.
 EEPROM_SIMULATED_SIZE = 512
 
+# When running on a computer, the simulated EEPROM can also count the
+# number of bytes read from, written to and erased in it, how long an
+# AVR would have been busy performing those operations, and how often
+# each byte has been erased and written. This makes it possible to
+# compare the cost of different configurations (which is what the
+# "bench" target of Makefile.linux does), and to estimate how long the
+# EEPROM will last. See EEPROM_GetSimulatedStats() and
+# EEPROM_PrintWear(). This setting has no effect when compiling for an
+# AVR.
+#  0 = Do not count accesses to the simulated EEPROM
+#  1 = Count accesses to the simulated EEPROM
+EEPROM_SIMULATED_COUNTERS = 0
+
 # ---------- End EEPROM Configuration Section ----------
 
 # ---------- DO NOT MODIFY BELOW THIS LINE ----------
@@ -50,6 +320,32 @@ endif
 #     $(EEPROM_DEFINES)
 # which should be appended to the definition of COMPILE in the Makefile
 EEPROM_DEFINES = -DEEPROM_WEAR_LEVEL_FACTOR=$(EEPROM_WEAR_LEVEL_FACTOR) \
+                 -DEEPROM_PER_PARAMETER_LEVELS=$(EEPROM_PER_PARAMETER_LEVELS) \
+                 -DEEPROM_WIDE_LEVELS=$(EEPROM_WIDE_LEVELS) \
                  -DEEPROM_INCLUDE_BLOCK_FUNCS=$(EEPROM_INCLUDE_BLOCK_FUNCS) \
+                 -DEEPROM_ROTATE_WHOLE_BLOCKS=$(EEPROM_ROTATE_WHOLE_BLOCKS) \
+                 -DEEPROM_INCLUDE_VERSIONED_BLOCK_FUNCS=$(EEPROM_INCLUDE_VERSIONED_BLOCK_FUNCS) \
                  -DEEPROM_INCLUDE_BYTE_FUNCS=$(EEPROM_INCLUDE_BYTE_FUNCS) \
-                 -DEEPROM_SIMULATED_SIZE=$(EEPROM_SIMULATED_SIZE)
+                 -DEEPROM_INCLUDE_COUNTER_FUNCS=$(EEPROM_INCLUDE_COUNTER_FUNCS) \
+                 -DEEPROM_COUNTER_UNARY_SIZE=$(EEPROM_COUNTER_UNARY_SIZE) \
+                 -DEEPROM_INCLUDE_WEAR_FUNCS=$(EEPROM_INCLUDE_WEAR_FUNCS) \
+                 -DEEPROM_ENDURANCE=$(EEPROM_ENDURANCE) \
+                 -DEEPROM_INCLUDE_PARAMETER_FUNCS=$(EEPROM_INCLUDE_PARAMETER_FUNCS) \
+                 -DEEPROM_WRITE_BACK_SIZE=$(EEPROM_WRITE_BACK_SIZE) \
+                 -DEEPROM_LOG_SIZE=$(EEPROM_LOG_SIZE) \
+                 -DEEPROM_LOG_BEGIN=$(EEPROM_LOG_BEGIN) \
+                 -DEEPROM_LOG_KEYS=$(EEPROM_LOG_KEYS) \
+                 -DEEPROM_CACHE_SIZE=$(EEPROM_CACHE_SIZE) \
+                 -DEEPROM_BINARY_SEARCH=$(EEPROM_BINARY_SEARCH) \
+                 -DEEPROM_WRITE_QUEUE_SIZE=$(EEPROM_WRITE_QUEUE_SIZE) \
+                 -DEEPROM_DEFERRED_WRITES=$(EEPROM_DEFERRED_WRITES) \
+                 -DEEPROM_SPLIT_PROGRAMMING=$(EEPROM_SPLIT_PROGRAMMING) \
+                 -DEEPROM_SLEEP_WHILE_PROGRAMMING=$(EEPROM_SLEEP_WHILE_PROGRAMMING) \
+                 -DEEPROM_BIT_CLEARING_STATUS=$(EEPROM_BIT_CLEARING_STATUS) \
+                 -DEEPROM_PROFILING=$(EEPROM_PROFILING) \
+                 $(if $(EEPROM_PROFILE_TIMER),-DEEPROM_PROFILE_TIMER=$(EEPROM_PROFILE_TIMER)) \
+                 -DEEPROM_BACKEND=$(EEPROM_BACKEND) \
+                 -DEEPROM_PAGE_SIZE=$(EEPROM_PAGE_SIZE) \
+                 -DEEPROM_EXTERNAL_SIZE=$(EEPROM_EXTERNAL_SIZE) \
+                 -DEEPROM_SIMULATED_SIZE=$(EEPROM_SIMULATED_SIZE) \
+                 -DEEPROM_SIMULATED_COUNTERS=$(EEPROM_SIMULATED_COUNTERS)
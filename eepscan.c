@@ -0,0 +1,277 @@
+/*
+
+  eepscan.c
+
+  Copyright 2015 Matthew T. Pandina. All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY MATTHEW T. PANDINA "AS IS" AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHEW T. PANDINA OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+  USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+
+/*
+  Decodes dumps of the EEPROM read back from devices (for example with
+  "avrdude -U eeprom:r:dump.eep:i"), as raw binary or Intel HEX files,
+  and prints, for every parameter of the layout in layout.h, its
+  current value, the number of times it has been written, and whether
+  its metadata is valid, one tab-separated line per parameter of each
+  dump. The values are read by the same accessors the firmware uses,
+  from the simulated EEPROM, and the status buffers are decoded
+  straight from the dump by EEPROM_AnalyzeStatusBuffer. This is built
+  and run by "make -f Makefile.linux scan", using the configuration in
+  eeprom.mk (or given on the command line), which must be the one the
+  firmware was built with.
+
+  The state of a parameter is "valid", "blank" if it was never
+  initialized, "corrupt" if any of its status buffers is neither, or
+  "truncated" if the dump ends before its segment does. The number of
+  writes is only known modulo the number printed after it, and for a
+  block stored byte by byte, is that of its most written byte.
+
+  Note: The types of the parameters must have the same size and byte
+        order on the computer as on the AVR, such as fixed-width
+        integer types and packed structs.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "layout.h"
+
+#define EEPSCAN_MAX_LINE 600
+#define EEPSCAN_DATA 0x00
+#define EEPSCAN_END_OF_FILE 0x01
+
+enum { SCAN_VALID, SCAN_BLANK, SCAN_CORRUPT, SCAN_TRUNCATED, SCAN_STATE_COUNT };
+static const char *const ScanStateNames[SCAN_STATE_COUNT] = { "valid", "blank", "corrupt", "truncated" };
+
+typedef struct {
+  const char *name;
+  uint16_t offset;
+  uint16_t size;
+  uint16_t len;
+  EEPROM_Level levels;
+  void (*read)(uint8_t *data);
+} ScanParameter;
+
+#define SCAN_READER(name, type, ...)             \
+  static void ScanRead##name(uint8_t *data) {    \
+    type value;                                  \
+    EEPROM_Read##name(&value);                   \
+    memcpy(data, &value, sizeof(type));          \
+  }
+EEPROM_PARAMETERS(SCAN_READER)
+#undef SCAN_READER
+
+#define SCAN_PARAMETER(name, type, ...) \
+  { #name, EE_OFFSET(name), EE_SIZE(name), sizeof(type), EE_LEVELS(__VA_ARGS__), ScanRead##name },
+static const ScanParameter ScanParameters[] = {
+  EEPROM_PARAMETERS(SCAN_PARAMETER)
+};
+#undef SCAN_PARAMETER
+
+static uint8_t ScanDump[EEPROM_SIMULATED_SIZE];
+// Large enough for the value of any parameter
+static uint8_t ScanValue[EE_EEPROM_END];
+
+static int ScanHexDigits(const char *s, const uint8_t digits, uint16_t *value) {
+  *value = 0;
+  for (uint8_t i = 0; i < digits; ++i) {
+    char c = s[i];
+    uint8_t digit;
+    if (c >= '0' && c <= '9')
+      digit = c - '0';
+    else if (c >= 'A' && c <= 'F')
+      digit = c - 'A' + 10;
+    else if (c >= 'a' && c <= 'f')
+      digit = c - 'a' + 10;
+    else
+      return -1;
+    *value = (*value << 4) | digit;
+  }
+  return 0;
+}
+
+// Reads an Intel HEX file into ScanDump, returning the number of bytes
+// up to the last one it holds, or -1 if it is malformed
+static long ScanLoadHex(FILE *file, const char *path) {
+  char line[EEPSCAN_MAX_LINE];
+  long size = 0;
+  uint32_t number = 0;
+  while (fgets(line, sizeof(line), file)) {
+    ++number;
+    size_t n = strcspn(line, "\r\n");
+    if (!n)
+      continue;
+    uint16_t len, address, type, byte;
+    if (line[0] != ':' || n < 11 || ScanHexDigits(&line[1], 2, &len) || ScanHexDigits(&line[3], 4, &address) ||
+        ScanHexDigits(&line[7], 2, &type) || n != 11 + (size_t)len * 2) {
+      fprintf(stderr, "%s:%u: malformed record\n", path, number);
+      return -1;
+    }
+    uint8_t sum = 0;
+    for (uint16_t i = 0; i < 4 + len; ++i) {
+      ScanHexDigits(&line[1 + i * 2], 2, &byte);
+      sum += byte;
+    }
+    if (ScanHexDigits(&line[9 + len * 2], 2, &byte) || (uint8_t)(sum + byte)) {
+      fprintf(stderr, "%s:%u: bad checksum\n", path, number);
+      return -1;
+    }
+    if (type == EEPSCAN_END_OF_FILE)
+      return size;
+    if (type != EEPSCAN_DATA) {
+      fprintf(stderr, "%s:%u: unsupported record type %02X\n", path, number, type);
+      return -1;
+    }
+    if ((uint32_t)address + len > sizeof(ScanDump)) {
+      fprintf(stderr, "%s:%u: larger than EEPROM_SIMULATED_SIZE (%u)\n", path, number, EEPROM_SIMULATED_SIZE);
+      return -1;
+    }
+    for (uint16_t i = 0; i < len; ++i) {
+      ScanHexDigits(&line[9 + i * 2], 2, &byte);
+      ScanDump[address + i] = byte;
+    }
+    if ((long)address + len > size)
+      size = address + len;
+  }
+  fprintf(stderr, "%s: missing end of file record\n", path);
+  return -1;
+}
+
+// Reads a dump into ScanDump, every byte it does not hold being erased,
+// returning its size, or -1 if it could not be read
+static long ScanLoad(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    perror(path);
+    return -1;
+  }
+  memset(ScanDump, 0xFF, sizeof(ScanDump));
+  long size;
+  int c = fgetc(file);
+  if (c == ':') {
+    ungetc(c, file);
+    size = ScanLoadHex(file, path);
+  } else {
+    if (c != EOF)
+      ungetc(c, file);
+    size = fread(ScanDump, 1, sizeof(ScanDump), file);
+    if (ferror(file)) {
+      perror(path);
+      size = -1;
+    } else if (fgetc(file) != EOF) {
+      fprintf(stderr, "%s: larger than EEPROM_SIMULATED_SIZE (%u)\n", path, EEPROM_SIMULATED_SIZE);
+      size = -1;
+    }
+  }
+  fclose(file);
+  return size;
+}
+
+#if (EEPROM_BACKEND != 2)
+// Combines the analysis of one of the status buffers of a parameter
+static void ScanStatus(const uint16_t status, const EEPROM_Level levels, uint8_t *state, uint32_t *writes, uint32_t *period) {
+  EEPROM_StatusAnalysis analysis;
+  EEPROM_AnalyzeStatusBuffer(&ScanDump[status], levels, &analysis);
+  if (analysis.state == EE_STATUS_CORRUPT)
+    *state = SCAN_CORRUPT;
+  else if (analysis.state == EE_STATUS_BLANK && *state == SCAN_VALID)
+    *state = SCAN_BLANK;
+  if (analysis.writes > *writes)
+    *writes = analysis.writes;
+  *period = analysis.period;
+}
+#endif // EEPROM_BACKEND
+
+// Prints every parameter of a dump, returning the number of them
+// whose state is not valid
+static uint32_t ScanPrint(const char *path, const long size) {
+  uint32_t invalid = 0;
+  for (uint16_t p = 0; p < sizeof(ScanParameters) / sizeof(ScanParameters[0]); ++p) {
+    const ScanParameter *param = &ScanParameters[p];
+    uint8_t state = SCAN_VALID;
+    uint32_t writes = 0;
+    uint32_t period = 0;
+    if ((long)param->offset + param->size > size)
+      state = SCAN_TRUNCATED;
+#if (EEPROM_BACKEND != 2)
+#if (EEPROM_ROTATE_WHOLE_BLOCKS)
+    else
+      ScanStatus(param->offset + (uint16_t)param->levels * param->len, param->levels, &state, &writes, &period);
+#else // EEPROM_ROTATE_WHOLE_BLOCKS
+    else
+      for (uint16_t i = 0; i < param->len; ++i)
+        ScanStatus(param->offset + i * EE_BYTE_SEGMENT_SIZE_N(param->levels) + param->levels, param->levels,
+                   &state, &writes, &period);
+#endif // EEPROM_ROTATE_WHOLE_BLOCKS
+#endif // EEPROM_BACKEND
+
+    printf("%s\t%s\t", path, param->name);
+    if (state == SCAN_TRUNCATED || state == SCAN_BLANK) {
+      printf("-");
+    } else {
+      param->read(ScanValue);
+      for (uint16_t i = 0; i < param->len; ++i)
+        printf("%02X", ScanValue[i]);
+    }
+    if (period && state != SCAN_TRUNCATED && state != SCAN_BLANK)
+      printf("\t%u\t%u", writes, period);
+    else
+      printf("\t-\t-");
+    printf("\t%s\n", ScanStateNames[state]);
+    invalid += (state != SCAN_VALID);
+  }
+  return invalid;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s DUMP...\n", argv[0]);
+    return 2;
+  }
+
+  uint32_t dumps = 0;
+  uint32_t invalid = 0;
+  int status = 0;
+  printf("dump\tparameter\tvalue\twrites\tmodulo\tstate\n");
+  for (int i = 1; i < argc; ++i) {
+    long size = ScanLoad(argv[i]);
+    if (size < 0) {
+      status = 1;
+      continue;
+    }
+    memcpy(eeprom, ScanDump, sizeof(eeprom));
+#if (EEPROM_CACHE_SIZE)
+    EEPROM_InvalidateCache();
+#endif // EEPROM_CACHE_SIZE
+    invalid += ScanPrint(argv[i], size);
+    ++dumps;
+  }
+  fflush(stdout);
+  fprintf(stderr, "%u dumps, %u parameters not valid\n", dumps, invalid);
+  return status;
+}
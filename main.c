@@ -31,20 +31,10 @@
 */
 
 #include <stdint.h>
+#include "layout.h"
 
-uint8_t volume = 0x40;
-
-struct __attribute__ ((__packed__)) settings_t {
-  uint16_t score;
-  uint8_t level;
-};
-struct settings_t settings = {0x00FD, 0x01};
-
-// EEPROM parameter offsets (EE_EPROM_END should be defined before including eeprom.h)
-#define EE_VOLUME     0
-#define EE_SETTINGS   (EE_VOLUME + sizeof(volume) * EEPROM_WEAR_LEVEL_FACTOR * 2)
-#define EE_EEPROM_END (EE_SETTINGS + sizeof(struct settings_t) * EEPROM_WEAR_LEVEL_FACTOR * 2)
-#include "eeprom.h"
+uint8_t volume = VOLUME_DEFAULT;
+struct settings_t settings = SETTINGS_DEFAULT;
 
 int main(void) {
   /*
@@ -70,7 +60,7 @@ int main(void) {
     ...
   */
 
-  EEPROM_InitWearLeveledBlock(EE_SETTINGS, &settings, sizeof(settings));
+  EEPROM_InitSettings(&settings);
   /*
     The contents of the struct settings_t
     ({0x00FD, 0x01}) have been stored, and each
@@ -85,7 +75,7 @@ int main(void) {
   */
 
   volume = EEPROM_ReadWearLeveledByte(EE_VOLUME);
-  EEPROM_ReadWearLeveledBlock(EE_SETTINGS, &settings, sizeof(settings));
+  EEPROM_ReadSettings(&settings);
   /*
     Reading wear-leveled bytes and/or blocks does
     not modify the contents of the EEPROM:
@@ -113,7 +103,7 @@ int main(void) {
   */
 
   settings.score++;
-  EEPROM_WriteWearLeveledBlock(EE_SETTINGS, &settings, sizeof(settings));
+  EEPROM_WriteSettings(&settings);
   /*
     The new contents of the EE_SETTINGS parameter
     ({0x00FE, 0x01}) have been stored, but since
@@ -131,7 +121,7 @@ int main(void) {
   */
 
   settings.score++;
-  EEPROM_WriteWearLeveledBlock(EE_SETTINGS, &settings, sizeof(settings));
+  EEPROM_WriteSettings(&settings);
   /*
     The new contents of the EE_SETTINGS parameter
     ({0x00FF, 0x01}) have been stored, and only a
@@ -150,7 +140,7 @@ int main(void) {
   */
 
   settings.score++;
-  EEPROM_WriteWearLeveledBlock(EE_SETTINGS, &settings, sizeof(settings));
+  EEPROM_WriteSettings(&settings);
   /*
     The new contents of the EE_SETTINGS parameter
     ({0x0100, 0x01}) have been stored, and since
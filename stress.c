@@ -0,0 +1,366 @@
+/*
+
+  stress.c
+
+  Copyright 2015 Matthew T. Pandina. All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY MATTHEW T. PANDINA "AS IS" AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHEW T. PANDINA OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+  USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+  Simulates many devices at once, one per thread, each with its own
+  simulated EEPROM (see EEPROM_CreateInstance), writing randomly
+  chosen wear-leveled bytes and blocks with random values, the
+  parameters written most often being chosen far more often than the
+  rest. After every write, the value read back is checked, and every
+  so often, the device is reset part way through a write, after which
+  every parameter must hold either its old or its new value (and when
+  whole blocks are rotated, the whole block must). At the end, the
+  throughput, the bytes written per write, and how evenly the bytes of
+  the EEPROM were erased are reported. This is built and run by "make
+  -f Makefile.linux stress", using the configuration in eeprom.mk (or
+  given on the command line).
+
+  A reset is simulated by undoing the bytes changed by a write, and
+  then redoing only some of them: first the bytes of the param
+  buffers, and then the bytes of the status buffers, each in order of
+  address, which is an order the library may write them in.
+*/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "eeprom.h"
+
+#if (!EEPROM_SIMULATED_COUNTERS)
+#error "stress.c requires EEPROM_SIMULATED_COUNTERS = 1"
+#endif // EEPROM_SIMULATED_COUNTERS
+
+#define STRESS_MAX_LEN 12
+// One write in this many is interrupted by a reset
+#define STRESS_RESET_ODDS 16
+// Every parameter is checked once every this many writes
+#define STRESS_CHECK_EVERY 256
+
+// The kind of each parameter, and where its segment begins
+enum { KIND_BYTE, KIND_BLOCK };
+typedef struct {
+  uint8_t kind;
+  uint16_t len;
+  uint16_t param;
+  uint16_t size;
+} StressParameter;
+
+static const uint16_t StressBlockLengths[] = { 2, 5, STRESS_MAX_LEN };
+
+static StressParameter StressParams[16];
+static uint8_t StressParamCount;
+static uint16_t StressEnd; // the address after the last segment
+
+static void StressLayout(void) {
+  uint16_t param = 0;
+#if (EEPROM_INCLUDE_BYTE_FUNCS)
+  for (uint8_t i = 0; i < 4; ++i) {
+    StressParams[StressParamCount++] = (StressParameter){ KIND_BYTE, 1, param, EE_BYTE_SEGMENT_SIZE };
+    param += EE_BYTE_SEGMENT_SIZE;
+  }
+#endif // EEPROM_INCLUDE_BYTE_FUNCS
+#if (EEPROM_INCLUDE_BLOCK_FUNCS)
+  for (uint8_t i = 0; i < sizeof(StressBlockLengths) / sizeof(StressBlockLengths[0]); ++i) {
+    StressParams[StressParamCount++] = (StressParameter){ KIND_BLOCK, StressBlockLengths[i], param,
+                                                         EE_BLOCK_SEGMENT_SIZE(StressBlockLengths[i]) };
+    param += EE_BLOCK_SEGMENT_SIZE(StressBlockLengths[i]);
+  }
+#endif // EEPROM_INCLUDE_BLOCK_FUNCS
+  StressEnd = param;
+}
+
+// Returns whether an address in the segment of a parameter belongs to a status buffer
+static uint8_t StressIsStatus(const StressParameter *p, const uint16_t address) {
+#if (EEPROM_BACKEND == 2)
+  (void)p;
+  (void)address;
+  return 0;
+#else // EEPROM_BACKEND
+  uint16_t offset = address - p->param;
+#if (EEPROM_ROTATE_WHOLE_BLOCKS)
+  if (p->kind == KIND_BLOCK)
+    return offset >= p->len * EEPROM_WEAR_LEVEL_FACTOR;
+#endif // EEPROM_ROTATE_WHOLE_BLOCKS
+  return offset % EE_BYTE_SEGMENT_SIZE >= EEPROM_WEAR_LEVEL_FACTOR;
+#endif // EEPROM_BACKEND
+}
+
+// Whether a reset part way through a write leaves every byte of a
+// block old or new, rather than the whole block
+#define STRESS_BYTEWISE (EEPROM_BACKEND == 2 || !EEPROM_ROTATE_WHOLE_BLOCKS)
+
+static void StressRead(const StressParameter *p, uint8_t *data) {
+#if (EEPROM_INCLUDE_BYTE_FUNCS)
+  if (p->kind == KIND_BYTE) {
+    data[0] = EEPROM_ReadWearLeveledByte(p->param);
+    return;
+  }
+#endif // EEPROM_INCLUDE_BYTE_FUNCS
+#if (EEPROM_INCLUDE_BLOCK_FUNCS)
+  EEPROM_ReadWearLeveledBlock(p->param, data, p->len);
+#endif // EEPROM_INCLUDE_BLOCK_FUNCS
+}
+
+static void StressWrite(const StressParameter *p, const uint8_t *data) {
+#if (EEPROM_INCLUDE_BYTE_FUNCS)
+  if (p->kind == KIND_BYTE)
+    EEPROM_WriteWearLeveledByte(p->param, data[0]);
+#endif // EEPROM_INCLUDE_BYTE_FUNCS
+#if (EEPROM_INCLUDE_BLOCK_FUNCS)
+  if (p->kind == KIND_BLOCK)
+    EEPROM_WriteWearLeveledBlock(p->param, data, p->len);
+#endif // EEPROM_INCLUDE_BLOCK_FUNCS
+#if (EEPROM_WRITE_QUEUE_SIZE)
+  EEPROM_FlushWrites();
+#endif // EEPROM_WRITE_QUEUE_SIZE
+}
+
+static void StressInit(const StressParameter *p, const uint8_t *data) {
+#if (EEPROM_INCLUDE_BYTE_FUNCS)
+  if (p->kind == KIND_BYTE)
+    EEPROM_InitWearLeveledByte(p->param, data[0]);
+#endif // EEPROM_INCLUDE_BYTE_FUNCS
+#if (EEPROM_INCLUDE_BLOCK_FUNCS)
+  if (p->kind == KIND_BLOCK)
+    EEPROM_InitWearLeveledBlock(p->param, data, p->len);
+#endif // EEPROM_INCLUDE_BLOCK_FUNCS
+#if (EEPROM_WRITE_QUEUE_SIZE)
+  EEPROM_FlushWrites();
+#endif // EEPROM_WRITE_QUEUE_SIZE
+}
+
+// The results of one simulated device
+typedef struct {
+  pthread_t thread;
+  uint32_t seed;
+  uint32_t steps;
+  uint32_t resets;
+  uint8_t failed;
+  EEPROM_SimulatedStats stats;
+  uint32_t minErases;
+  uint32_t maxErases;
+  uint64_t totalErases;
+} StressDevice;
+
+static uint32_t StressSteps = 1000000;
+
+static uint32_t StressRandom(uint32_t *state) {
+  // xorshift32
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+// Picks a parameter, the first being picked most often
+static uint8_t StressPick(uint32_t *state) {
+  double u = (StressRandom(state) >> 8) / (double)(1 << 24);
+  return (uint8_t)(u * u * u * StressParamCount);
+}
+
+static void StressFail(StressDevice *device, const uint32_t step, const char *what, const StressParameter *p) {
+  printf("FAIL seed %u step %u: %s of the %s at %u\n", device->seed, step, what,
+         p->kind == KIND_BYTE ? "byte" : "block", p->param);
+  device->failed = 1;
+}
+
+static void *StressRun(void *arg) {
+  StressDevice *device = arg;
+  EEPROM_Instance *instance = EEPROM_CreateInstance();
+  if (!instance) {
+    printf("FAIL seed %u: out of memory\n", device->seed);
+    device->failed = 1;
+    return NULL;
+  }
+  EEPROM_SelectInstance(instance);
+
+  static __thread uint8_t before[EEPROM_SIMULATED_SIZE], after[EEPROM_SIMULATED_SIZE];
+  static __thread uint16_t order[EEPROM_SIMULATED_SIZE];
+  uint8_t values[sizeof(StressParams) / sizeof(StressParams[0])][STRESS_MAX_LEN] = { { 0 } };
+  uint8_t data[STRESS_MAX_LEN], old[STRESS_MAX_LEN], read[STRESS_MAX_LEN];
+  uint32_t state = device->seed;
+
+  for (uint8_t i = 0; i < StressParamCount; ++i)
+    StressInit(&StressParams[i], values[i]);
+  EEPROM_ResetSimulatedStats();
+
+  for (uint32_t step = 0; step < StressSteps && !device->failed; ++step) {
+    uint8_t index = StressPick(&state);
+    const StressParameter *p = &StressParams[index];
+
+    // Keep the value, or change one byte, or change every byte
+    memcpy(old, values[index], p->len);
+    memcpy(data, old, p->len);
+    uint32_t pattern = StressRandom(&state) % 4;
+    if (pattern == 1)
+      data[StressRandom(&state) % p->len] = StressRandom(&state);
+    else if (pattern > 1)
+      for (uint16_t i = 0; i < p->len; ++i)
+        data[i] = StressRandom(&state);
+
+    uint8_t reset = StressRandom(&state) % STRESS_RESET_ODDS == 0;
+    if (reset)
+      memcpy(before, eeprom, StressEnd);
+    StressWrite(p, data);
+    memcpy(values[index], data, p->len);
+
+    if (reset) {
+      // Redo the param buffer bytes, then the status buffer bytes, up
+      // to the point of the reset
+      memcpy(after, eeprom, StressEnd);
+      uint16_t count = 0;
+      for (uint8_t status = 0; status < 2; ++status)
+        for (uint16_t a = p->param; a < p->param + p->size; ++a)
+          if (before[a] != after[a] && StressIsStatus(p, a) == status)
+            order[count++] = a;
+      if (count) {
+        uint16_t done = StressRandom(&state) % count;
+        memcpy(eeprom, before, StressEnd);
+        for (uint16_t i = 0; i < done; ++i)
+          eeprom[order[i]] = after[order[i]];
+      }
+#if (EEPROM_CACHE_SIZE)
+      EEPROM_InvalidateCache();
+#endif // EEPROM_CACHE_SIZE
+      ++device->resets;
+
+      StressRead(p, read);
+#if (STRESS_BYTEWISE)
+      for (uint16_t i = 0; i < p->len; ++i)
+        if (read[i] != old[i] && read[i] != data[i])
+          StressFail(device, step, "torn write", p);
+#else // STRESS_BYTEWISE
+      if (memcmp(read, old, p->len) && memcmp(read, data, p->len))
+        StressFail(device, step, "torn write", p);
+#endif // STRESS_BYTEWISE
+      memcpy(values[index], read, p->len);
+    } else {
+      StressRead(p, read);
+      if (memcmp(read, data, p->len))
+        StressFail(device, step, "read back", p);
+    }
+
+    if (reset || step % STRESS_CHECK_EVERY == 0) {
+      for (uint8_t i = 0; i < StressParamCount; ++i) {
+        StressRead(&StressParams[i], read);
+        if (memcmp(read, values[i], StressParams[i].len))
+          StressFail(device, step, "check", &StressParams[i]);
+      }
+    }
+    device->steps = step + 1;
+  }
+
+  EEPROM_GetSimulatedStats(&device->stats);
+  device->minErases = UINT32_MAX;
+  for (uint16_t a = 0; a < StressEnd; ++a) {
+    uint32_t erases = EEPROM_SimulatedCellErases(a);
+    if (erases < device->minErases)
+      device->minErases = erases;
+    if (erases > device->maxErases)
+      device->maxErases = erases;
+    device->totalErases += erases;
+  }
+
+  EEPROM_SelectInstance(NULL);
+  EEPROM_DestroyInstance(instance);
+  return NULL;
+}
+
+static double StressNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (argc > 1)
+    threads = atol(argv[1]);
+  if (argc > 2)
+    StressSteps = atol(argv[2]);
+  if (threads < 1)
+    threads = 1;
+
+  StressLayout();
+  if (!StressParamCount || StressEnd > sizeof(eeprom)) {
+    printf("FAIL: the parameters do not fit into EEPROM_SIMULATED_SIZE = %u bytes\n", EEPROM_SIMULATED_SIZE);
+    return 1;
+  }
+
+  printf("EEPROM_WEAR_LEVEL_FACTOR = %u, EEPROM_ROTATE_WHOLE_BLOCKS = %u, EEPROM_BIT_CLEARING_STATUS = %u, "
+         "EEPROM_CACHE_SIZE = %u, EEPROM_WRITE_QUEUE_SIZE = %u, EEPROM_BACKEND = %u\n",
+         EEPROM_WEAR_LEVEL_FACTOR, EEPROM_ROTATE_WHOLE_BLOCKS, EEPROM_BIT_CLEARING_STATUS,
+         EEPROM_CACHE_SIZE, EEPROM_WRITE_QUEUE_SIZE, EEPROM_BACKEND);
+  printf("%ld devices, %u writes each, %u parameters in %u bytes\n", threads, StressSteps, StressParamCount, StressEnd);
+
+  StressDevice *devices = calloc(threads, sizeof(*devices));
+  if (!devices)
+    return 1;
+  double begin = StressNow();
+  for (long i = 0; i < threads; ++i) {
+    devices[i].seed = 0x9E3779B9u * (uint32_t)(i + 1);
+    if (pthread_create(&devices[i].thread, NULL, StressRun, &devices[i]))
+      return 1;
+  }
+
+  uint64_t steps = 0, resets = 0, writes = 0, totalErases = 0;
+  uint32_t minErases = UINT32_MAX, maxErases = 0;
+  int failed = 0;
+  for (long i = 0; i < threads; ++i) {
+    pthread_join(devices[i].thread, NULL);
+    failed |= devices[i].failed;
+    steps += devices[i].steps;
+    resets += devices[i].resets;
+    writes += devices[i].stats.writes;
+    totalErases += devices[i].totalErases;
+    if (devices[i].minErases < minErases)
+      minErases = devices[i].minErases;
+    if (devices[i].maxErases > maxErases)
+      maxErases = devices[i].maxErases;
+  }
+  double seconds = StressNow() - begin;
+
+  double meanErases = (double)totalErases / threads / StressEnd;
+  printf("%llu writes (%llu interrupted by a reset) in %.2f s, %.0f writes/s\n",
+         (unsigned long long)steps, (unsigned long long)resets, seconds, steps / seconds);
+  printf("bytes written per write: %.2f\n", (double)writes / steps);
+  printf("erases per byte: min %u, mean %.1f, max %u (max/mean %.2f)\n",
+         minErases, meanErases, maxErases, meanErases ? maxErases / meanErases : 0.0);
+  printf("%s\n", failed ? "FAILED" : "passed");
+  free(devices);
+  return failed;
+}